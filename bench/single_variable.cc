@@ -0,0 +1,76 @@
+#include "single_variable.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <utility>
+
+using Autodiff::SingleVariable;
+
+namespace {
+
+/*!
+ * 二項演算 f(a, b) を一回評価する時間を測る
+ * coeffs/s は出力の係数の数、bytes は入出力の SingleVariable 三つ分で数える
+ **/
+template <size_t Order, class F>
+void single(benchmark::State &state, F f) {
+  using SV = SingleVariable<Order, double>;
+  const auto t = SV(0.3);
+  auto a = 0.4 + 0.2 * t;
+  auto b = 0.7 - 0.1 * t;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    auto r = f(a, b);
+    benchmark::DoNotOptimize(r);
+  }
+  state.counters["coeffs/s"] = benchmark::Counter(
+      Order + 1, benchmark::Counter::kIsIterationInvariantRate);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * 3 *
+                          static_cast<int64_t>(sizeof(SV)));
+}
+
+template <size_t Order> void register_order() {
+  const auto add = [](const char *op, auto f) {
+    const auto name =
+        "SingleVariable<" + std::to_string(Order) + ">/" + std::string(op);
+    benchmark::RegisterBenchmark(name.c_str(), single<Order, decltype(f)>, f);
+  };
+  add("add", [](const auto &a, const auto &b) { return a + b; });
+  add("sub", [](const auto &a, const auto &b) { return a - b; });
+  add("mul", [](const auto &a, const auto &b) { return a * b; });
+  add("div", [](const auto &a, const auto &b) { return a / b; });
+  add("scale", [](const auto &a, const auto &) { return 3. * a; });
+  add("inv", [](const auto &a, const auto &) { return a.inv(); });
+  add("pow", [](const auto &a, const auto &) { return a.pow(1.4); });
+  add("sqrt", [](const auto &a, const auto &) { return a.sqrt(); });
+  add("cbrt", [](const auto &a, const auto &) { return a.cbrt(); });
+  add("exp", [](const auto &a, const auto &) { return a.exp(); });
+  add("log", [](const auto &a, const auto &) { return a.log(); });
+  add("sin", [](const auto &a, const auto &) { return a.sin(); });
+  add("cos", [](const auto &a, const auto &) { return a.cos(); });
+  add("sincos", [](const auto &a, const auto &) { return a.sincos(); });
+  add("tan", [](const auto &a, const auto &) { return a.tan(); });
+  add("asin", [](const auto &a, const auto &) { return a.asin(); });
+  add("atan", [](const auto &a, const auto &) { return a.atan(); });
+  add("sinh", [](const auto &a, const auto &) { return a.sinh(); });
+  add("cosh", [](const auto &a, const auto &) { return a.cosh(); });
+  add("tanh", [](const auto &a, const auto &) { return a.tanh(); });
+  add("erf", [](const auto &a, const auto &) { return a.erf(); });
+  add("expm1", [](const auto &a, const auto &) { return a.expm1(); });
+  add("log1p", [](const auto &a, const auto &) { return a.log1p(); });
+  add("pow2", [](const auto &a, const auto &b) { return pow(a, b); });
+  add("atan2", [](const auto &a, const auto &b) { return atan2(a, b); });
+  add("hypot", [](const auto &a, const auto &b) { return hypot(a, b); });
+}
+
+// 1-7 階に加えて、テイラー法の常微分方程式で使う長い級数も測る
+template <size_t... Orders> bool register_orders() {
+  (register_order<Orders>(), ...);
+  return true;
+}
+
+const bool registered = register_orders<1, 2, 3, 4, 5, 6, 7, 16, 32, 64, 128>();
+
+} // namespace
@@ -0,0 +1,94 @@
+#include "variable.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+using Autodiff::Variable;
+
+namespace {
+
+// すべての係数が埋まった Variable (値は value)
+template <size_t Deps, size_t Order> Variable<Deps, Order> dense(double value) {
+  Variable<Deps, Order> ret;
+  for (size_t i = 0; i < ret.repr.size(); i++) {
+    ret.repr[i] = 0.1 / static_cast<double>(i + 1);
+  }
+  ret.repr[0] = value;
+  return ret;
+}
+
+/*!
+ * 二項演算 f(a, b) を一回評価する時間を測る
+ * coeffs/s は出力の係数の数、bytes は入出力三つ分の係数で数える
+ * (PooledStorage のポインタや依存先のビット列は数えない)
+ **/
+template <size_t Deps, size_t Order, class F>
+void variable(benchmark::State &state, F f) {
+  auto a = dense<Deps, Order>(0.4);
+  auto b = dense<Deps, Order>(0.7);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    auto r = f(a, b);
+    benchmark::DoNotOptimize(r);
+  }
+  state.counters["coeffs/s"] = benchmark::Counter(
+      static_cast<double>(a.repr.size()),
+      benchmark::Counter::kIsIterationInvariantRate);
+  state.SetBytesProcessed(
+      static_cast<int64_t>(state.iterations()) * 3 *
+      static_cast<int64_t>(a.repr.size() * sizeof(double)));
+}
+
+template <size_t Deps, size_t Order> void register_shape() {
+  const auto add = [](const char *op, auto f) {
+    const auto name = "Variable<" + std::to_string(Deps) + ", " +
+                      std::to_string(Order) + ">/" + std::string(op);
+    benchmark::RegisterBenchmark(name.c_str(),
+                                 variable<Deps, Order, decltype(f)>, f);
+  };
+  add("add", [](const auto &a, const auto &b) { return a + b; });
+  add("sub", [](const auto &a, const auto &b) { return a - b; });
+  add("mul", [](const auto &a, const auto &b) { return a * b; });
+  add("div", [](const auto &a, const auto &b) { return a / b; });
+  add("scale", [](const auto &a, const auto &) { return 3. * a; });
+  add("mul_assign", [](auto a, const auto &b) { return a *= b; });
+  add("inv", [](const auto &a, const auto &) { return a.inv(); });
+  add("pow", [](const auto &a, const auto &) { return a.pow(1.4); });
+  add("sqrt", [](const auto &a, const auto &) { return a.sqrt(); });
+  add("cbrt", [](const auto &a, const auto &) { return a.cbrt(); });
+  add("exp", [](const auto &a, const auto &) { return a.exp(); });
+  add("log", [](const auto &a, const auto &) { return a.log(); });
+  add("sin", [](const auto &a, const auto &) { return a.sin(); });
+  add("cos", [](const auto &a, const auto &) { return a.cos(); });
+  add("tan", [](const auto &a, const auto &) { return a.tan(); });
+  add("asin", [](const auto &a, const auto &) { return a.asin(); });
+  add("atan", [](const auto &a, const auto &) { return a.atan(); });
+  add("sinh", [](const auto &a, const auto &) { return a.sinh(); });
+  add("cosh", [](const auto &a, const auto &) { return a.cosh(); });
+  add("tanh", [](const auto &a, const auto &) { return a.tanh(); });
+  add("erf", [](const auto &a, const auto &) { return a.erf(); });
+  add("expm1", [](const auto &a, const auto &) { return a.expm1(); });
+  add("log1p", [](const auto &a, const auto &) { return a.log1p(); });
+  add("pow2", [](const auto &a, const auto &b) { return pow(a, b); });
+  add("atan2", [](const auto &a, const auto &b) { return atan2(a, b); });
+  add("hypot", [](const auto &a, const auto &b) { return hypot(a, b); });
+}
+
+template <size_t Deps, size_t... Orders> void register_deps() {
+  (register_shape<Deps, Orders>(), ...);
+}
+
+// Deps × Order の格子
+const bool registered = [] {
+  register_deps<1, 1, 2, 3, 4>();
+  register_deps<2, 1, 2, 3, 4>();
+  register_deps<4, 1, 2, 3, 4>();
+  register_deps<8, 1, 2, 3, 4>();
+  // 係数が VariableInlineBytes を超え PooledStorage に置かれる大きさ
+  register_deps<20, 3>();
+  return true;
+}();
+
+} // namespace
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace Autodiff {
+
+/*!
+ * 記録用のバンプアロケータ
+ *
+ * BlockSize 個ずつの連続したブロックに要素を詰めていき、足りなくなったら
+ * ブロックを追加する。伸ばすときに既存の要素をコピーせず、reset()
+ * はメモリを解放せずに先頭に戻るだけなので、同じ大きさの記録を繰り返す限り
+ * 最初の一回のあとはヒープ確保が起きない。
+ **/
+template <class T, size_t BlockSize = 4096> class Arena {
+  static_assert(std::is_trivially_copyable_v<T>);
+  static_assert((BlockSize & (BlockSize - 1)) == 0,
+                "BlockSize must be a power of two");
+
+public:
+  T &push(const T &value) {
+    if (this->count == this->capacity()) [[unlikely]] {
+      this->blocks.push_back(std::make_unique_for_overwrite<T[]>(BlockSize));
+    }
+    auto &ret = (*this)[this->count++];
+    ret = value;
+    this->peak_count = std::max(this->peak_count, this->count);
+    return ret;
+  }
+
+  [[nodiscard]] T &operator[](size_t i) {
+    return this->blocks[i / BlockSize][i % BlockSize];
+  }
+
+  [[nodiscard]] const T &operator[](size_t i) const {
+    return this->blocks[i / BlockSize][i % BlockSize];
+  }
+
+  // 少なくとも n 個を確保しておく
+  void reserve(size_t n) {
+    while (this->capacity() < n) {
+      this->blocks.push_back(std::make_unique_for_overwrite<T[]>(BlockSize));
+    }
+  }
+
+  // メモリを保持したまま空にする
+  void reset() { this->count = 0; }
+
+  [[nodiscard]] size_t size() const { return this->count; }
+
+  [[nodiscard]] size_t capacity() const {
+    return this->blocks.size() * BlockSize;
+  }
+
+  // これまでに記録した最大の要素数
+  [[nodiscard]] size_t peak() const { return this->peak_count; }
+
+private:
+  std::vector<std::unique_ptr<T[]>> blocks;
+  size_t count = 0;
+  size_t peak_count = 0;
+};
+
+} // namespace Autodiff
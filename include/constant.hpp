@@ -1,109 +1,111 @@
 #pragma once
 
 #include <array>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 
 namespace Autodiff {
 
 // autodiff::variable  で用いる定数を記述する
+// 表はコンパイラの constexpr の計算量の上限 (-fconstexpr-ops-limit) に
+// 収まる範囲で constexpr に生成する。上限は (Deps, Order) の両方で決まり、
+// 大きすぎる展開表は schedule.hpp で実行時に作る (ScheduleConstexprTerms)。
+// 一変数関数の合成に使う集合の分割の表だけは Order で決まり、ベル数で増えるので
+// Order <= SetPartitionsMaxOrder まで (Deps は任意) とする。
 
-// ```python
-// def foo(n: int, depth: int | None = None) -> Generator[list[int], None,
-// None]:
-//    depth = depth if depth is not None else n
-//    if depth == 0:
-//        yield []
-//        return
-//
-//    for i in foo(n, depth - 1):
-//        k = copy.deepcopy(i)
-//        k.append(depth)
-//        yield sorted(k, reverse=True)
-//        k = copy.deepcopy(i)
-//        k.append(0)
-//        yield sorted(k, reverse=True)
-// ```
-// によって生成される数列を定数として記録する
-inline const auto MULT_COEFF = std::array<std::vector<std::vector<uint8_t>>, 5>{
-    std::vector<std::vector<uint8_t>>{{}},                             //
-    std::vector<std::vector<uint8_t>>{{1}, {0}},                       //
-    std::vector<std::vector<uint8_t>>{{2, 1}, {1, 0}, {2, 0}, {0, 0}}, //
-    std::vector<std::vector<uint8_t>>{
-        {3, 2, 1},
-        {2, 1, 0},
-        {3, 1, 0},
-        {1, 0, 0},
-        {3, 2, 0},
-        {2, 0, 0},
-        {3, 0, 0},
-        {0, 0, 0},
-    },
-    std::vector<std::vector<uint8_t>>{
-        {4, 3, 2, 1},
-        {3, 2, 1, 0},
-        {4, 2, 1, 0},
-        {2, 1, 0, 0},
-        {4, 3, 1, 0},
-        {3, 1, 0, 0},
-        {4, 1, 0, 0},
-        {1, 0, 0, 0},
-        {4, 3, 2, 0},
-        {3, 2, 0, 0},
-        {4, 2, 0, 0},
-        {2, 0, 0, 0},
-        {4, 3, 0, 0},
-        {3, 0, 0, 0},
-        {4, 0, 0, 0},
-        {0, 0, 0, 0},
-    }};
+// 二項係数 nCk (n < k のときは 0)
+constexpr size_t binomial(size_t n, size_t k) {
+  if (k > n) {
+    return 0;
+  }
+  size_t ret = 1;
+  for (size_t i = 1; i <= k; i++) {
+    ret = ret * (n - k + i) / i;
+  }
+  return ret;
+}
 
-// ```python
-// def single_coeff(
-//     n: int, depth: int | None = None
-// ) -> Generator[list[list[int]], None, None]:
-//     depth = depth if depth is not None else n
-//     if depth == 0:
-//         yield []
-//         return
-//
-//     for i in single_coeff(n, depth - 1):
-//         for j in range(len(i)):
-//             ret = copy.deepcopy(i)
-//             ret[j].append(depth)
-//             yield sorted(ret)
-//
-//         ret = copy.deepcopy(i)
-//         ret.append([depth])
-//
-//         yield sorted(ret)
-// ```
-//
-inline const auto SINGLE_COEFF =
-    std::array<std::vector<std::vector<std::vector<uint8_t>>>, 5>{
-        std::vector<std::vector<std::vector<uint8_t>>>{{}},
-        std::vector<std::vector<std::vector<uint8_t>>>{{{1}}},
-        std::vector<std::vector<std::vector<uint8_t>>>{{{1, 2}}, {{1}, {2}}},
-        std::vector<std::vector<std::vector<uint8_t>>>{
-            {{1, 2, 3}},
-            {{1, 2}, {3}},
-            {{1, 3}, {2}},
-            {{1}, {2, 3}},
-            {{1}, {2}, {3}}},
-        std::vector<std::vector<std::vector<uint8_t>>>{{{1, 2, 3, 4}},
-                                                       {{1, 2, 3}, {4}},
-                                                       {{1, 2, 4}, {3}},
-                                                       {{1, 2}, {3, 4}},
-                                                       {{1, 2}, {3}, {4}},
-                                                       {{1, 3, 4}, {2}},
-                                                       {{1, 3}, {2, 4}},
-                                                       {{1, 3}, {2}, {4}},
-                                                       {{1, 4}, {2, 3}},
-                                                       {{1}, {2, 3, 4}},
-                                                       {{1}, {2, 3}, {4}},
-                                                       {{1, 4}, {2}, {3}},
-                                                       {{1}, {2, 4}, {3}},
-                                                       {{1}, {2}, {3, 4}},
-                                                       {{1}, {2}, {3}, {4}}},
-    };
+// size_t に収まる最大のベル数 B(25)
+inline constexpr size_t BellMax = 25;
+
+// ベル数 (n 個の要素からなる集合の分割の数)
+constexpr size_t bell(size_t n) {
+  if (n > BellMax) {
+    throw std::runtime_error("bell: n > BellMax (overflows size_t)");
+  }
+  std::array<size_t, BellMax + 1> b{1};
+  for (size_t m = 0; m < n; m++) {
+    for (size_t k = 0; k <= m; k++) {
+      b[m + 1] += binomial(m, k) * b[k];
+    }
+  }
+  return b[n];
+}
+
+/*!
+ * SetPartitions を作れる最大の次数
+ * 表の大きさは Σ B(k) で、Order = 9 では既定の -fconstexpr-ops-limit を超える
+ **/
+inline constexpr size_t SetPartitionsMaxOrder = 8;
+
+/*!
+ * 集合 {0, ..., k - 1} (k <= Order) の分割の一覧
+ *
+ * 分割は制限成長列で表し、分割 p で要素 i が属するブロックを block[p][i]、
+ * ブロック数を blocks[p] に持つ。k 要素の分割は [start[k], start[k + 1]) にある。
+ * Faà di Bruno の公式の和をとるのに用いる。
+ **/
+template <size_t Order> struct SetPartitions {
+  static_assert(Order <= SetPartitionsMaxOrder,
+                "SetPartitions: Order exceeds SetPartitionsMaxOrder");
+
+  static constexpr size_t SIZE = [] {
+    size_t ret = 0;
+    for (size_t k = 0; k <= Order; k++) {
+      ret += bell(k);
+    }
+    return ret;
+  }();
+
+  struct Table {
+    std::array<size_t, Order + 2> start{};
+    std::array<std::array<uint8_t, Order>, SIZE> block{};
+    std::array<uint8_t, SIZE> blocks{};
+  };
+
+  static constexpr Table TABLE = [] {
+    Table ret{};
+    size_t p = 0;
+    for (size_t k = 0; k <= Order; k++) {
+      ret.start[k] = p;
+      std::array<uint8_t, Order> rgs{};
+      for (const auto end = p + bell(k); p < end; p++) {
+        ret.block[p] = rgs;
+        uint8_t max = 0;
+        for (size_t i = 0; i < k; i++) {
+          max = rgs[i] + 1 > max ? rgs[i] + 1 : max;
+        }
+        ret.blocks[p] = max;
+        // 末尾から増やせる位置 (それより前の最大値以下) を探して増やす
+        for (size_t i = k; i-- > 1;) {
+          uint8_t prefix_max = 0;
+          for (size_t j = 0; j < i; j++) {
+            prefix_max = rgs[j] > prefix_max ? rgs[j] : prefix_max;
+          }
+          if (rgs[i] <= prefix_max) {
+            rgs[i]++;
+            for (size_t j = i + 1; j < k; j++) {
+              rgs[j] = 0;
+            }
+            break;
+          }
+        }
+      }
+    }
+    ret.start[Order + 1] = p;
+    return ret;
+  }();
+};
 
 } // namespace Autodiff
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "single_variable.hpp"
+
+namespace Autodiff {
+
+/*!
+ * SingleVariable の遅延評価 (式テンプレート)
+ *
+ * lazy(x) で包んだ式では +, -, スカラー倍, スカラーでの割り算が係数ごとの式の
+ * ノードになり、SingleVariable に代入したときに一度だけ評価される。
+ * 畳み込みになる積と商はその場で評価する。
+ * 左辺値の SingleVariable は参照で、右辺値は値で保持するので、式を auto
+ * で受けても一時オブジェクトを参照し続けることはない。
+ **/
+namespace Expression {
+
+template <class T> struct Traits {};
+
+template <std::size_t Order, std::floating_point ValType>
+struct Traits<SingleVariable<Order, ValType>> {
+  static constexpr std::size_t ORDER = Order;
+  using value_type = ValType;
+};
+
+template <class T>
+concept Single = requires { Traits<std::remove_cvref_t<T>>::ORDER; };
+
+template <class T>
+concept Expr = requires { typename std::remove_cvref_t<T>::expression_tag; };
+
+template <class T>
+concept Operand = Single<T> || Expr<T>;
+
+// 少なくとも一方が式のときだけ遅延評価の演算子を使う
+template <class L, class R>
+concept LazyPair = Operand<L> && Operand<R> && (Expr<L> || Expr<R>);
+
+template <class Derived, std::size_t Order, class ValType> struct Base {
+  using expression_tag = void;
+  using value_type = ValType;
+  using result_type = SingleVariable<Order, ValType>;
+  static constexpr std::size_t ORDER = Order;
+
+  [[nodiscard]] constexpr result_type eval() const {
+    result_type ret{};
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      ret.set_coefficient(i, static_cast<const Derived &>(*this)[i]);
+    }
+    return ret;
+  }
+
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  constexpr operator result_type() const { return this->eval(); }
+};
+
+template <class SV>
+struct Ref : Base<Ref<SV>, Traits<SV>::ORDER, typename Traits<SV>::value_type> {
+  explicit constexpr Ref(const SV &value) : value(value) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return value.coefficient(i);
+  }
+
+  const SV &value;
+};
+
+template <class SV>
+struct Value
+    : Base<Value<SV>, Traits<SV>::ORDER, typename Traits<SV>::value_type> {
+  explicit constexpr Value(SV value) : value(std::move(value)) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return value.coefficient(i);
+  }
+
+  SV value;
+};
+
+template <class L, class R>
+struct Add : Base<Add<L, R>, L::ORDER, typename L::value_type> {
+  static_assert(L::ORDER == R::ORDER);
+
+  constexpr Add(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return lhs[i] + rhs[i];
+  }
+
+  L lhs;
+  R rhs;
+};
+
+template <class L, class R>
+struct Sub : Base<Sub<L, R>, L::ORDER, typename L::value_type> {
+  static_assert(L::ORDER == R::ORDER);
+
+  constexpr Sub(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return lhs[i] - rhs[i];
+  }
+
+  L lhs;
+  R rhs;
+};
+
+template <class E>
+struct Negate : Base<Negate<E>, E::ORDER, typename E::value_type> {
+  explicit constexpr Negate(E expr) : expr(std::move(expr)) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return -expr[i];
+  }
+
+  E expr;
+};
+
+// 定数項にだけスカラーを足す
+template <class E>
+struct Shift : Base<Shift<E>, E::ORDER, typename E::value_type> {
+  constexpr Shift(E expr, typename E::value_type value)
+      : expr(std::move(expr)), value(value) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return i == 0 ? expr[i] + value : expr[i];
+  }
+
+  E expr;
+  typename E::value_type value;
+};
+
+template <class E>
+struct Scale : Base<Scale<E>, E::ORDER, typename E::value_type> {
+  constexpr Scale(E expr, typename E::value_type value)
+      : expr(std::move(expr)), value(value) {}
+
+  [[nodiscard]] constexpr auto operator[](std::size_t i) const {
+    return expr[i] * value;
+  }
+
+  E expr;
+  typename E::value_type value;
+};
+
+// 演算子の引数をノードとして保持できる形にする
+template <Operand T> constexpr auto wrap(T &&operand) {
+  using Type = std::remove_cvref_t<T>;
+  if constexpr (Expr<T>) {
+    return Type(std::forward<T>(operand));
+  } else if constexpr (std::is_lvalue_reference_v<T>) {
+    return Ref<Type>(operand);
+  } else {
+    return Value<Type>(std::move(operand));
+  }
+}
+
+// 畳み込みのために SingleVariable として評価する
+template <Operand T> constexpr decltype(auto) materialize(T &&operand) {
+  if constexpr (Expr<T>) {
+    return operand.eval();
+  } else {
+    return std::forward<T>(operand);
+  }
+}
+
+template <Expr E>
+using value_type_t = typename std::remove_cvref_t<E>::value_type;
+
+template <class L, class R>
+  requires LazyPair<L, R>
+[[nodiscard]] constexpr auto operator+(L &&lhs, R &&rhs) {
+  return Add(wrap(std::forward<L>(lhs)), wrap(std::forward<R>(rhs)));
+}
+
+template <class L, class R>
+  requires LazyPair<L, R>
+[[nodiscard]] constexpr auto operator-(L &&lhs, R &&rhs) {
+  return Sub(wrap(std::forward<L>(lhs)), wrap(std::forward<R>(rhs)));
+}
+
+template <Expr E> [[nodiscard]] constexpr auto operator-(E &&expr) {
+  return Negate(wrap(std::forward<E>(expr)));
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator+(E &&expr,
+                                       const value_type_t<E> &value) {
+  return Shift(wrap(std::forward<E>(expr)), value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator+(const value_type_t<E> &value,
+                                       E &&expr) {
+  return Shift(wrap(std::forward<E>(expr)), value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator-(E &&expr,
+                                       const value_type_t<E> &value) {
+  return Shift(wrap(std::forward<E>(expr)), -value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator-(const value_type_t<E> &value,
+                                       E &&expr) {
+  return Shift(Negate(wrap(std::forward<E>(expr))), value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator*(E &&expr,
+                                       const value_type_t<E> &value) {
+  return Scale(wrap(std::forward<E>(expr)), value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator*(const value_type_t<E> &value,
+                                       E &&expr) {
+  return Scale(wrap(std::forward<E>(expr)), value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator/(E &&expr,
+                                       const value_type_t<E> &value) {
+  return Scale(wrap(std::forward<E>(expr)), 1 / value);
+}
+
+template <Expr E>
+[[nodiscard]] constexpr auto operator/(const value_type_t<E> &value,
+                                       E &&expr) {
+  return wrap(value / materialize(std::forward<E>(expr)));
+}
+
+template <class L, class R>
+  requires LazyPair<L, R>
+[[nodiscard]] constexpr auto operator*(L &&lhs, R &&rhs) {
+  return wrap(materialize(std::forward<L>(lhs)) *
+              materialize(std::forward<R>(rhs)));
+}
+
+template <class L, class R>
+  requires LazyPair<L, R>
+[[nodiscard]] constexpr auto operator/(L &&lhs, R &&rhs) {
+  return wrap(materialize(std::forward<L>(lhs)) /
+              materialize(std::forward<R>(rhs)));
+}
+
+} // namespace Expression
+
+// x を遅延評価の式の葉にする
+template <std::size_t Order, std::floating_point ValType>
+[[nodiscard]] constexpr auto lazy(const SingleVariable<Order, ValType> &x) {
+  return Expression::Ref<SingleVariable<Order, ValType>>(x);
+}
+
+template <std::size_t Order, std::floating_point ValType>
+[[nodiscard]] constexpr auto lazy(SingleVariable<Order, ValType> &&x) {
+  return Expression::Value<SingleVariable<Order, ValType>>(std::move(x));
+}
+
+} // namespace Autodiff
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "constant.hpp"
+
+namespace Autodiff {
+
+/*!
+ * 入力の集合を表すビット列 (i 番目の入力は i - 1 ビット目)
+ * std::bitset は C++23 の実装でないと constexpr で使えないので自前で持つ
+ **/
+template <size_t Deps> struct DepMask {
+  static constexpr size_t WORDS = (Deps + 63) / 64;
+
+  std::array<uint64_t, WORDS> words{};
+
+  [[nodiscard]] static constexpr DepMask full() {
+    DepMask ret;
+    for (size_t i = 1; i <= Deps; i++) {
+      ret.set(i);
+    }
+    return ret;
+  }
+
+  constexpr void set(size_t index) {
+    words[(index - 1) / 64] |= uint64_t{1} << ((index - 1) % 64);
+  }
+
+  [[nodiscard]] constexpr bool test(size_t index) const {
+    return (words[(index - 1) / 64] >> ((index - 1) % 64) & 1) != 0;
+  }
+
+  [[nodiscard]] constexpr bool all() const { return *this == full(); }
+
+  [[nodiscard]] constexpr bool subset_of(const DepMask &other) const {
+    for (size_t i = 0; i < WORDS; i++) {
+      if ((words[i] & ~other.words[i]) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  constexpr DepMask &operator|=(const DepMask &rhs) {
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i] |= rhs.words[i];
+    }
+    return *this;
+  }
+
+  [[nodiscard]] friend constexpr DepMask operator|(DepMask lhs,
+                                                   const DepMask &rhs) {
+    lhs |= rhs;
+    return lhs;
+  }
+
+  constexpr bool operator==(const DepMask &) const = default;
+};
+
+/*!
+ * Variable の係数を詰めて格納するための添字表
+ *
+ * 多重添字は降順にソートした長さ Order の配列で表し、0 は「微分しない」を表す。
+ * 対称性から降順の多重添字だけが意味を持つので、それらを次数 (0
+ * でない要素の数) の順に並べて binomial(Deps + Order, Order) 個に詰める。
+ * 次数 k の係数は offset(k) から始まり、同じ次数の中では組み合わせ数系で並ぶ。
+ * 例えば勾配は [1, Deps + 1)、ヘッセ行列は下三角を行優先で詰めた並びになる。
+ **/
+template <size_t Deps, size_t Order> struct MultiIndex {
+  using Index = std::array<size_t, Order>;
+
+  static constexpr size_t SIZE = binomial(Deps + Order, Order);
+
+  // 二項係数の表 CHOOSE[n][k] = nCk (n <= Deps + Order, k <= Order)
+  // rank を表の生成の中で何度も呼ぶので、毎回 binomial を計算しない
+  static constexpr auto CHOOSE = [] {
+    std::array<std::array<size_t, Order + 1>, Deps + Order + 1> ret{};
+    for (size_t n = 0; n <= Deps + Order; n++) {
+      ret[n][0] = 1;
+      for (size_t k = 1; k <= Order && k <= n; k++) {
+        ret[n][k] = ret[n - 1][k - 1] + (k < n ? ret[n - 1][k] : 0);
+      }
+    }
+    return ret;
+  }();
+
+  // 次数 degree の係数が始まる位置
+  [[nodiscard]] static constexpr size_t offset(size_t degree) {
+    return degree == 0 ? 0 : CHOOSE[Deps + degree - 1][degree - 1];
+  }
+
+  [[nodiscard]] static constexpr size_t degree(const Index &idx) {
+    size_t ret = 0;
+    while (ret < Order && idx[ret] != 0) {
+      ret++;
+    }
+    return ret;
+  }
+
+  // 降順の多重添字から詰めた位置を求める
+  [[nodiscard]] static constexpr size_t rank(const Index &idx) {
+    const auto k = degree(idx);
+    auto ret = offset(k);
+    for (size_t i = 0; i < k; i++) {
+      ret += CHOOSE[idx[i] + k - i - 2][k - i];
+    }
+    return ret;
+  }
+
+  // 詰めた位置 → 多重添字
+  // 詰めた順に生成して末尾に書き足す (定数評価では順不同の書き込みが遅い)
+  static constexpr std::array<Index, SIZE> TABLE = [] {
+    std::array<Index, SIZE> ret{};
+    size_t n = 0;
+    for (size_t k = 0; k <= Order; k++) {
+      Index idx{};
+      for (size_t i = 0; i < k; i++) {
+        idx[i] = 1;
+      }
+      for (const auto end = offset(k + 1); n < end; n++) {
+        ret[n] = idx;
+        // 右端から増やせる位置を探し、それより右を 1 に戻す
+        for (size_t j = k; j-- > 0;) {
+          if (idx[j] < (j == 0 ? Deps : idx[j - 1])) {
+            idx[j]++;
+            for (size_t l = j + 1; l < k; l++) {
+              idx[l] = 1;
+            }
+            break;
+          }
+        }
+      }
+    }
+    return ret;
+  }();
+};
+
+/*!
+ * K 階の微分テンソルを行優先の Deps^K 要素に展開するための表
+ *
+ * TABLE[i] は行優先の位置 i = ((j_1 Deps + j_2) Deps + ...) + j_K
+ * (j は 0 始まり) の成分が Variable の詰めた並びのどこにあるかを表す。
+ **/
+template <size_t Deps, size_t Order, size_t K> struct TensorIndex {
+  static_assert(1 <= K && K <= Order);
+
+  static constexpr size_t SIZE = [] {
+    size_t ret = 1;
+    for (size_t i = 0; i < K; i++) {
+      ret *= Deps;
+    }
+    return ret;
+  }();
+
+  static_assert(MultiIndex<Deps, Order>::SIZE <= UINT32_MAX);
+
+  static constexpr std::array<uint32_t, SIZE> TABLE = [] {
+    std::array<uint32_t, SIZE> ret{};
+    for (size_t i = 0; i < SIZE; i++) {
+      typename MultiIndex<Deps, Order>::Index idx{};
+      for (size_t j = K, rest = i; j-- > 0; rest /= Deps) {
+        idx[j] = rest % Deps + 1;
+      }
+      std::sort(idx.begin(), idx.begin() + K, std::greater<>());
+      ret[i] = static_cast<uint32_t>(MultiIndex<Deps, Order>::rank(idx));
+    }
+    return ret;
+  }();
+};
+
+} // namespace Autodiff
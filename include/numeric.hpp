@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+
+namespace Autodiff {
+
+/*!
+ * SingleVariable や Variable の係数に使える数の性質
+ *
+ * 浮動小数点数のほか SingleVariable と Variable もこれを特殊化しているので、
+ * 互いの係数にして入れ子にできる (SingleVariable<2, SingleVariable<2>> など)。
+ * Real は一番内側の浮動小数点数、constant は Real から定数を作り、
+ * is_zero はすべての係数が 0 かどうかを返す。
+ **/
+template <class T> struct NumericTraits;
+
+template <std::floating_point T> struct NumericTraits<T> {
+  using Real = T;
+
+  [[nodiscard]] static constexpr T constant(Real value) { return value; }
+
+  [[nodiscard]] static constexpr bool is_zero(const T &value) {
+    return value == 0;
+  }
+};
+
+template <class T>
+concept Numeric = requires(const T &a, const T &b,
+                           typename NumericTraits<T>::Real r) {
+  { NumericTraits<T>::constant(r) } -> std::same_as<T>;
+  { NumericTraits<T>::is_zero(a) } -> std::same_as<bool>;
+  { a + b } -> std::same_as<T>;
+  { a - b } -> std::same_as<T>;
+  { a * b } -> std::same_as<T>;
+  { a / b } -> std::same_as<T>;
+  { -a } -> std::same_as<T>;
+};
+
+template <Numeric T> using RealOf = typename NumericTraits<T>::Real;
+
+/*!
+ * 入れ子のときの一番内側の実数 (Real) との演算を Derived に足す (CRTP)
+ *
+ * ValType が浮動小数点数なら Derived 自身の ValType との演算と同じなので
+ * 何も足さない。Derived は ValType との / と、係数の配列を返す非公開の
+ * coeffs() を持ち、このクラスを friend にして複合代入を using すること。
+ **/
+template <class Derived, Numeric ValType> class RealScalarOps {
+  using Real = RealOf<ValType>;
+  static constexpr bool NESTED = !std::same_as<ValType, Real>;
+
+  [[nodiscard]] constexpr Derived &self() {
+    return static_cast<Derived &>(*this);
+  }
+
+public:
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  constexpr Derived &operator+=(const S &rhs) {
+    self().coeffs()[0] += static_cast<Real>(rhs);
+    return self();
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  constexpr Derived &operator-=(const S &rhs) {
+    self().coeffs()[0] -= static_cast<Real>(rhs);
+    return self();
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  constexpr Derived &operator*=(const S &rhs) {
+    for (auto &&v : self().coeffs()) {
+      v *= static_cast<Real>(rhs);
+    }
+    return self();
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  constexpr Derived &operator/=(const S &rhs) {
+    return self() *= Real{1} / static_cast<Real>(rhs);
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator+(Derived lhs, const S &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator+(const S &lhs, Derived rhs) {
+    rhs += lhs;
+    return rhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator-(Derived lhs, const S &rhs) {
+    lhs -= rhs;
+    return lhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator-(const S &lhs, Derived rhs) {
+    rhs *= Real{-1};
+    rhs += lhs;
+    return rhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator*(Derived lhs, const S &rhs) {
+    lhs *= rhs;
+    return lhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator*(const S &lhs, Derived rhs) {
+    rhs *= lhs;
+    return rhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator/(Derived lhs, const S &rhs) {
+    lhs /= rhs;
+    return lhs;
+  }
+
+  template <std::convertible_to<Real> S>
+    requires NESTED
+  [[nodiscard]] friend constexpr Derived operator/(const S &lhs,
+                                                   const Derived &rhs) {
+    return NumericTraits<ValType>::constant(static_cast<Real>(lhs)) / rhs;
+  }
+};
+
+/*!
+ * 係数の初等関数
+ *
+ * 浮動小数点数なら std:: の関数を、SingleVariable や Variable なら
+ * hidden friend を ADL で呼ぶ。クラスの中ではメンバ関数 sin などが
+ * 非修飾名を隠してしまうので、係数に対しては必ずこちらを使う。
+ **/
+namespace Math {
+
+// clang-format off
+template <class T> constexpr T sin(const T &x) { using std::sin; return sin(x); }
+template <class T> constexpr T cos(const T &x) { using std::cos; return cos(x); }
+template <class T> constexpr T tan(const T &x) { using std::tan; return tan(x); }
+template <class T> constexpr T asin(const T &x) { using std::asin; return asin(x); }
+template <class T> constexpr T atan(const T &x) { using std::atan; return atan(x); }
+template <class T> constexpr T sinh(const T &x) { using std::sinh; return sinh(x); }
+template <class T> constexpr T cosh(const T &x) { using std::cosh; return cosh(x); }
+template <class T> constexpr T tanh(const T &x) { using std::tanh; return tanh(x); }
+template <class T> constexpr T exp(const T &x) { using std::exp; return exp(x); }
+template <class T> constexpr T expm1(const T &x) { using std::expm1; return expm1(x); }
+template <class T> constexpr T log(const T &x) { using std::log; return log(x); }
+template <class T> constexpr T log1p(const T &x) { using std::log1p; return log1p(x); }
+template <class T> constexpr T erf(const T &x) { using std::erf; return erf(x); }
+// clang-format on
+
+template <class T, class U> constexpr T pow(const T &x, const U &y) {
+  using std::pow;
+  return pow(x, y);
+}
+
+template <class T> constexpr T atan2(const T &y, const T &x) {
+  using std::atan2;
+  return atan2(y, x);
+}
+
+template <class T> constexpr T hypot(const T &x, const T &y) {
+  using std::hypot;
+  return hypot(x, y);
+}
+
+} // namespace Math
+
+} // namespace Autodiff
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "variable.hpp"
+
+namespace Autodiff {
+
+/*!
+ * 多数の点で Variable の式を並列に評価する
+ *
+ * points[p] を値とする Deps 個の独立変数を f に渡し、結果 (微分係数を詰めた
+ * Variable) を out[p] に書き込む。点は BLOCK 個ずつのかたまりにして、
+ * 空いたスレッドが共有カウンタから次のかたまりを取っていく。
+ * 独立変数の配列はスレッドごとに持ち、出力はかたまり単位で連続しているので
+ * スレッド間でキャッシュラインを取り合うことはほとんどない。
+ * f が投げた例外は最初のものだけを全スレッドの終了後に投げ直す。
+ * ValType と Storage は Variable のものをそのまま指定する。
+ *
+ * ```cpp
+ * Autodiff::evaluate<2, 2>(
+ *     [](const auto &x) { return x[0] * x[1].sin(); }, points, out);
+ * ```
+ **/
+template <size_t Deps, size_t Order, Numeric ValType = double,
+          template <class, size_t> class Storage = AutoStorage, class F>
+  requires std::invocable<
+      F &, const std::array<Variable<Deps, Order, ValType, Storage>, Deps> &>
+void evaluate(
+    F &&f,
+    std::span<const std::array<std::type_identity_t<ValType>, Deps>> points,
+    std::span<std::type_identity_t<Variable<Deps, Order, ValType, Storage>>>
+        out,
+    size_t threads = std::thread::hardware_concurrency()) {
+  using Var = Variable<Deps, Order, ValType, Storage>;
+  constexpr size_t BLOCK = 64;
+
+  if (points.size() != out.size()) {
+    throw std::runtime_error("evaluate: points.size() != out.size()");
+  }
+  const auto blocks = (points.size() + BLOCK - 1) / BLOCK;
+  threads = std::clamp<size_t>(threads, 1, std::max<size_t>(blocks, 1));
+
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&] {
+    std::array<Var, Deps> seeds;
+    for (size_t i = 0; i < Deps; i++) {
+      seeds[i] = Var(ValType{}, i + 1);
+    }
+    try {
+      for (auto b = next.fetch_add(1, std::memory_order_relaxed); b < blocks;
+           b = next.fetch_add(1, std::memory_order_relaxed)) {
+        const auto end = std::min(points.size(), (b + 1) * BLOCK);
+        for (auto p = b * BLOCK; p < end; p++) {
+          for (size_t i = 0; i < Deps; i++) {
+            seeds[i].repr[0] = points[p][i];
+          }
+          out[p] = f(std::as_const(seeds));
+        }
+      }
+    } catch (...) {
+      const std::scoped_lock lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      // 残りのかたまりは処理しない
+      next.store(blocks, std::memory_order_relaxed);
+    }
+  };
+
+  if (threads == 1) {
+    worker();
+  } else {
+    std::vector<std::jthread> pool;
+    pool.reserve(threads - 1);
+    for (size_t t = 1; t < threads; t++) {
+      pool.emplace_back(worker);
+    }
+    worker();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace Autodiff
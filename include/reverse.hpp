@@ -0,0 +1,401 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "single_variable.hpp"
+
+namespace Autodiff {
+
+/*!
+ * テープに載せる値の型ごとの扱い
+ * 浮動小数点数のほか、ヘッセ行列とベクトルの積のために接ベクトルを一つ持つ
+ * SingleVariable<1> (値と方向微分の組) を載せられる。
+ **/
+template <class ValType> struct TapeTraits {};
+
+template <std::floating_point ValType> struct TapeTraits<ValType> {
+  using Real = ValType;
+
+  [[nodiscard]] static constexpr ValType constant(Real value) { return value; }
+
+  [[nodiscard]] static constexpr bool is_zero(const ValType &value) {
+    return value == 0;
+  }
+
+  // 一変数関数 f の値と微分係数を SingleVariable<1> で求める
+  template <class F>
+  [[nodiscard]] static constexpr std::pair<ValType, ValType>
+  unary(F &&f, const ValType &x) {
+    const auto r = f(SingleVariable<1, ValType>(x));
+    return {r.derivative(0), r.derivative(1)};
+  }
+};
+
+template <std::floating_point Real_>
+struct TapeTraits<SingleVariable<1, Real_>> {
+  using Real = Real_;
+  using Dual = SingleVariable<1, Real>;
+
+  [[nodiscard]] static constexpr Dual constant(Real value) {
+    return Dual::from_coefficients({value, 0});
+  }
+
+  [[nodiscard]] static constexpr bool is_zero(const Dual &value) {
+    return value.coefficient(0) == 0 && value.coefficient(1) == 0;
+  }
+
+  // x = a + b ε のとき f(x) = f(a) + f'(a) b ε, f'(x) = f'(a) + f''(a) b ε
+  template <class F>
+  [[nodiscard]] static constexpr std::pair<Dual, Dual> unary(F &&f,
+                                                             const Dual &x) {
+    const auto a = x.coefficient(0);
+    const auto b = x.coefficient(1);
+    const auto r = f(SingleVariable<2, Real>(a));
+    return {Dual::from_coefficients({r.derivative(0), r.derivative(1) * b}),
+            Dual::from_coefficients({r.derivative(1), r.derivative(2) * b})};
+  }
+};
+
+template <class ValType>
+concept TapeValue = requires { typename TapeTraits<ValType>::Real; };
+
+template <TapeValue ValType = double> class ReverseVariable;
+
+/*!
+ * リバースモードの自動微分のためのテープ
+ *
+ * 演算ごとに引数の位置と偏微分係数をノードとして記録し、backward()
+ * で出力から逆向きに随伴を伝播する。入力が多く出力が一つの関数では
+ * 勾配全体が関数の評価の定数倍の手間で求まる。
+ * 一変数関数の微分係数は SingleVariable<1> の規則をそのまま使う。
+ *
+ * ノードは Arena に詰めるので、clear() して同じ関数を評価し直す限り
+ * 最初の一回のあとはヒープ確保が起きない。peak() を見て reserve()
+ * しておけば最初の一回の確保もまとめられる。
+ **/
+template <TapeValue ValType = double> class Tape {
+  using Traits = TapeTraits<ValType>;
+
+public:
+  // 引数は常に二つとし、使わない引数は自分自身を指して係数を 0 にする
+  struct Node {
+    std::array<size_t, 2> arg;
+    std::array<ValType, 2> partial;
+  };
+
+  // 独立変数を記録する
+  [[nodiscard]] ReverseVariable<ValType> variable(ValType value) {
+    const auto index = this->nodes.size();
+    this->nodes.push({{index, index}, {ValType{}, ValType{}}});
+    return ReverseVariable<ValType>(value, index, this);
+  }
+
+  /*!
+   * n 個の独立変数を value(i) の値でまとめて記録する
+   * 返す span はテープが持つ領域を指し、次に variables() か clear() を
+   * 呼ぶまで有効。領域は使い回すので、二回目からは確保が起きない
+   **/
+  template <class G>
+    requires std::invocable<G &, size_t>
+  [[nodiscard]] std::span<const ReverseVariable<ValType>>
+  variables(size_t n, G &&value) {
+    this->inputs.clear();
+    for (size_t i = 0; i < n; i++) {
+      this->inputs.push_back(this->variable(value(i)));
+    }
+    return this->inputs;
+  }
+
+  [[nodiscard]] size_t push(size_t arg, ValType partial) {
+    const auto index = this->nodes.size();
+    this->nodes.push({{arg, index}, {partial, ValType{}}});
+    return index;
+  }
+
+  [[nodiscard]] size_t push(size_t lhs, ValType lhs_partial, size_t rhs,
+                            ValType rhs_partial) {
+    const auto index = this->nodes.size();
+    this->nodes.push({{lhs, rhs}, {lhs_partial, rhs_partial}});
+    return index;
+  }
+
+  // output の各ノードに対する随伴を求める
+  void backward(const ReverseVariable<ValType> &output) {
+    if (output.tape != this) {
+      throw std::runtime_error("Tape::backward: output is not on this tape");
+    }
+    this->adjoints.assign(output.index + 1, ValType{});
+    this->adjoints[output.index] = Traits::constant(1);
+    for (size_t i = output.index + 1; i-- > 0;) {
+      const auto a = this->adjoints[i];
+      if (Traits::is_zero(a)) {
+        continue;
+      }
+      const auto &node = this->nodes[i];
+      auto &lhs = this->adjoints[node.arg[0]];
+      lhs = lhs + node.partial[0] * a;
+      auto &rhs = this->adjoints[node.arg[1]];
+      rhs = rhs + node.partial[1] * a;
+    }
+  }
+
+  // 直前の backward() の出力の variable に関する微分
+  [[nodiscard]] ValType adjoint(const ReverseVariable<ValType> &variable) const {
+    return variable.index < this->adjoints.size()
+               ? this->adjoints[variable.index]
+               : ValType{};
+  }
+
+  // メモリを保持したまま記録を消す
+  void clear() {
+    this->nodes.reset();
+    this->adjoints.clear();
+    this->inputs.clear();
+  }
+
+  void reserve(size_t n) {
+    this->nodes.reserve(n);
+    this->adjoints.reserve(n);
+  }
+
+  [[nodiscard]] size_t size() const { return this->nodes.size(); }
+
+  [[nodiscard]] size_t capacity() const { return this->nodes.capacity(); }
+
+  // これまでに記録した最大のノード数
+  [[nodiscard]] size_t peak() const { return this->nodes.peak(); }
+
+private:
+  Arena<Node> nodes;
+  std::vector<ValType> adjoints;
+  // variables() で記録した独立変数
+  std::vector<ReverseVariable<ValType>> inputs;
+};
+
+/*!
+ * テープに記録されるスカラー
+ **/
+template <TapeValue ValType> class ReverseVariable {
+  friend class Tape<ValType>;
+
+  using Traits = TapeTraits<ValType>;
+  using Real = typename Traits::Real;
+
+  ValType val{};
+  size_t index = 0;
+  Tape<ValType> *tape = nullptr;
+
+  constexpr ReverseVariable(ValType value, size_t index, Tape<ValType> *tape)
+      : val(value), index(index), tape(tape) {}
+
+  // 一変数関数 f を SingleVariable で評価して記録する
+  template <class F> [[nodiscard]] ReverseVariable unary(F &&f) const {
+    const auto [value, partial] = Traits::unary(f, this->val);
+    return {value, tape->push(this->index, partial), tape};
+  }
+
+  [[nodiscard]] ReverseVariable unary(ValType value, Real partial) const {
+    return {value, tape->push(this->index, Traits::constant(partial)), tape};
+  }
+
+  [[nodiscard]] ReverseVariable binary(const ReverseVariable &rhs,
+                                       ValType value, ValType lhs_partial,
+                                       ValType rhs_partial) const {
+    if (this->tape != rhs.tape) [[unlikely]] {
+      throw std::runtime_error("ReverseVariable: operands on different tapes");
+    }
+    return {value,
+            tape->push(this->index, lhs_partial, rhs.index, rhs_partial),
+            tape};
+  }
+
+public:
+  ReverseVariable() = default;
+
+  [[nodiscard]] constexpr ValType value() const { return this->val; }
+
+  [[nodiscard]] ValType adjoint() const { return tape->adjoint(*this); }
+
+  [[nodiscard]] ReverseVariable operator+(const ReverseVariable &rhs) const {
+    return binary(rhs, this->val + rhs.val, Traits::constant(1),
+                  Traits::constant(1));
+  }
+
+  [[nodiscard]] ReverseVariable operator+(const Real &rhs) const {
+    return unary(this->val + rhs, 1.);
+  }
+
+  [[nodiscard]] friend ReverseVariable operator+(const Real &lhs,
+                                                 const ReverseVariable &rhs) {
+    return rhs + lhs;
+  }
+
+  [[nodiscard]] ReverseVariable operator-() const {
+    return unary(-this->val, -1.);
+  }
+
+  [[nodiscard]] ReverseVariable operator-(const ReverseVariable &rhs) const {
+    return binary(rhs, this->val - rhs.val, Traits::constant(1),
+                  Traits::constant(-1));
+  }
+
+  [[nodiscard]] ReverseVariable operator-(const Real &rhs) const {
+    return unary(this->val - rhs, 1.);
+  }
+
+  [[nodiscard]] friend ReverseVariable operator-(const Real &lhs,
+                                                 const ReverseVariable &rhs) {
+    return rhs.unary(lhs - rhs.val, -1.);
+  }
+
+  [[nodiscard]] ReverseVariable operator*(const ReverseVariable &rhs) const {
+    return binary(rhs, this->val * rhs.val, rhs.val, this->val);
+  }
+
+  [[nodiscard]] ReverseVariable operator*(const Real &rhs) const {
+    return unary(this->val * rhs, rhs);
+  }
+
+  [[nodiscard]] friend ReverseVariable operator*(const Real &lhs,
+                                                 const ReverseVariable &rhs) {
+    return rhs * lhs;
+  }
+
+  [[nodiscard]] ReverseVariable operator/(const ReverseVariable &rhs) const {
+    const auto inv_value = Real{1} / rhs.val;
+    const auto value = this->val * inv_value;
+    return binary(rhs, value, inv_value, -value * inv_value);
+  }
+
+  [[nodiscard]] ReverseVariable operator/(const Real &rhs) const {
+    return *this * (1 / rhs);
+  }
+
+  [[nodiscard]] friend ReverseVariable operator/(const Real &lhs,
+                                                 const ReverseVariable &rhs) {
+    return rhs.inv() * lhs;
+  }
+
+  [[nodiscard]] ReverseVariable inv() const {
+    return unary([](const auto &x) { return x.inv(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable inv(const ReverseVariable &self) {
+    return self.inv();
+  }
+
+  [[nodiscard]] ReverseVariable pow(const Real &rhs) const {
+    return unary([&](const auto &x) { return x.pow(rhs); });
+  }
+
+  [[nodiscard]] friend ReverseVariable pow(const ReverseVariable &self,
+                                           const Real &rhs) {
+    return self.pow(rhs);
+  }
+
+  [[nodiscard]] ReverseVariable sqrt() const {
+    return unary([](const auto &x) { return x.sqrt(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable sqrt(const ReverseVariable &self) {
+    return self.sqrt();
+  }
+
+  [[nodiscard]] ReverseVariable cbrt() const {
+    return unary([](const auto &x) { return x.cbrt(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable cbrt(const ReverseVariable &self) {
+    return self.cbrt();
+  }
+
+  [[nodiscard]] ReverseVariable exp() const {
+    return unary([](const auto &x) { return x.exp(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable exp(const ReverseVariable &self) {
+    return self.exp();
+  }
+
+  [[nodiscard]] ReverseVariable log() const {
+    return unary([](const auto &x) { return x.log(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable log(const ReverseVariable &self) {
+    return self.log();
+  }
+
+  [[nodiscard]] ReverseVariable sin() const {
+    return unary([](const auto &x) { return x.sin(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable sin(const ReverseVariable &self) {
+    return self.sin();
+  }
+
+  [[nodiscard]] ReverseVariable cos() const {
+    return unary([](const auto &x) { return x.cos(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable cos(const ReverseVariable &self) {
+    return self.cos();
+  }
+
+  [[nodiscard]] ReverseVariable tan() const {
+    return unary([](const auto &x) { return x.tan(); });
+  }
+
+  [[nodiscard]] friend ReverseVariable tan(const ReverseVariable &self) {
+    return self.tan();
+  }
+};
+
+/*!
+ * ヘッセ行列とベクトルの積 (forward-over-reverse)
+ *
+ * 値と v 方向の微分を組にした SingleVariable<1> をテープに載せて f
+ * を評価し、逆向きに伝播する。随伴の値の部分が勾配、方向微分の部分が H v
+ * になるので、勾配数回分の手間と入力の数に比例するメモリで済む。
+ * f は ReverseVariable<SingleVariable<1>> の std::span を受け取る。
+ * 入力はテープの持つ領域に並べるので、同じテープで呼び直す限り
+ * 最初の一回のあとはヒープ確保が起きない。
+ **/
+template <std::floating_point Real, class F>
+void hessian_vector(Tape<SingleVariable<1, Real>> &tape, F &&f,
+                    std::span<const Real> x, std::span<const Real> v,
+                    std::span<Real> gradient, std::span<Real> hv) {
+  using Dual = SingleVariable<1, Real>;
+
+  if (x.size() != v.size() || x.size() != gradient.size() ||
+      x.size() != hv.size()) {
+    throw std::runtime_error("hessian_vector: size mismatch");
+  }
+  tape.clear();
+  const auto inputs = tape.variables(x.size(), [&](size_t i) {
+    return Dual::from_coefficients({x[i], v[i]});
+  });
+  const auto output = f(inputs);
+  tape.backward(output);
+  for (size_t i = 0; i < x.size(); i++) {
+    const auto adjoint = inputs[i].adjoint();
+    gradient[i] = adjoint.coefficient(0);
+    hv[i] = adjoint.coefficient(1);
+  }
+}
+
+// 一回だけ求めるとき用 (呼ぶたびにテープを作る)
+template <std::floating_point Real, class F>
+void hessian_vector(F &&f, std::span<const Real> x, std::span<const Real> v,
+                    std::span<Real> gradient, std::span<Real> hv) {
+  Tape<SingleVariable<1, Real>> tape;
+  hessian_vector(tape, std::forward<F>(f), x, v, gradient, hv);
+}
+
+} // namespace Autodiff
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "constant.hpp"
+#include "multi_index.hpp"
+
+namespace Autodiff {
+
+/*!
+ * 展開表をコンパイル時に作る最大の大きさ (項または因子の数)
+ * これを超える表を constexpr に作ると GCC の既定の -fconstexpr-ops-limit に
+ * 当たるので、最初に使うときに実行時に一度だけ作る。
+ * そのような (Deps, Order) の Variable の演算は定数式の中では使えない。
+ **/
+inline constexpr size_t ScheduleConstexprTerms = 16384;
+
+/*!
+ * Variable::operator* のためのライプニッツ則の展開表
+ *
+ * 出力の多重添字 S (次数 k) ごとに、S の位置の部分集合 T を 2^k 通り列挙し
+ * (lhs, rhs) = (T, S \ T) の詰めた位置を記録する。
+ * 出力 n の項は [START[n], START[n + 1]) にあり、部分集合はビットマスクの昇順
+ * (先頭が lhs = 空集合、末尾が rhs = 空集合) に並ぶ。
+ * Deps と Order だけで決まり、小さい表はコンパイル時に、大きい表は実行時に
+ * 生成する (ScheduleConstexprTerms)。表は table() で取り出す。
+ **/
+template <size_t Deps, size_t Order> struct MultSchedule {
+  using Index = MultiIndex<Deps, Order>;
+
+  static_assert(Index::SIZE <= UINT32_MAX);
+
+  static constexpr size_t TERMS = [] {
+    size_t ret = 0;
+    for (size_t k = 0; k <= Order; k++) {
+      ret += (Index::offset(k + 1) - Index::offset(k)) << k;
+    }
+    return ret;
+  }();
+
+  static constexpr bool CONSTEXPR_TABLE = TERMS <= ScheduleConstexprTerms;
+
+  // コンパイル時に作る表
+  struct Table {
+    std::array<uint32_t, Index::SIZE + 1> start{};
+    std::array<uint32_t, TERMS> lhs{};
+    std::array<uint32_t, TERMS> rhs{};
+  };
+
+  // 実行時に作る表
+  struct HeapTable {
+    std::vector<uint32_t> start = std::vector<uint32_t>(Index::SIZE + 1);
+    std::vector<uint32_t> lhs = std::vector<uint32_t>(TERMS);
+    std::vector<uint32_t> rhs = std::vector<uint32_t>(TERMS);
+  };
+
+  template <class T> static constexpr void fill(T &ret) {
+    size_t t = 0;
+    for (size_t n = 0; n < Index::SIZE; n++) {
+      const auto &idx = Index::TABLE[n];
+      const auto k = Index::degree(idx);
+      ret.start[n] = static_cast<uint32_t>(t);
+      for (size_t mask = 0; mask < (size_t{1} << k); mask++) {
+        // T と S \ T を配列に取り出さずに Index::rank と同じ和を足し上げる
+        const auto kl = static_cast<size_t>(std::popcount(mask));
+        const auto kr = k - kl;
+        auto l = Index::offset(kl);
+        auto r = Index::offset(kr);
+        for (size_t i = 0, nl = 0, nr = 0; i < k; i++) {
+          if ((mask >> i) & 1U) {
+            l += Index::CHOOSE[idx[i] + kl - nl - 2][kl - nl];
+            nl++;
+          } else {
+            r += Index::CHOOSE[idx[i] + kr - nr - 2][kr - nr];
+            nr++;
+          }
+        }
+        ret.lhs[t] = static_cast<uint32_t>(l);
+        ret.rhs[t] = static_cast<uint32_t>(r);
+        t++;
+      }
+    }
+    ret.start[Index::SIZE] = static_cast<uint32_t>(t);
+  }
+
+  // constexpr にしないことで、静的変数の初期化を定数評価しようとさせない
+  static HeapTable build_heap() {
+    HeapTable ret;
+    fill(ret);
+    return ret;
+  }
+
+  static constexpr Table TABLE = [] {
+    Table ret{};
+    fill(ret);
+    return ret;
+  }();
+
+  [[nodiscard]] static constexpr const auto &table() {
+    if constexpr (CONSTEXPR_TABLE) {
+      return TABLE;
+    } else {
+      static const HeapTable ret = build_heap();
+      return ret;
+    }
+  }
+};
+
+/*!
+ * Variable の一変数関数の合成 (Faà di Bruno の公式) のための展開表
+ *
+ * 出力の多重添字 S (次数 k >= 1) ごとに S の位置の分割を列挙し、各ブロックを
+ * 多重添字とみなした詰めた位置を factor に並べる。
+ * 出力 n の項は [start[n], start[n + 1])、項 t の因子は
+ * [factor_start[t], factor_start[t + 1]) にあり、因子の数が f の微分の階数になる。
+ * MultSchedule と同じく、因子の数が ScheduleConstexprTerms を超える表は実行時に
+ * 作る。分割の表は Order だけで決まるので、Order <= SetPartitionsMaxOrder なら
+ * Deps によらず作れる。
+ **/
+template <size_t Deps, size_t Order> struct CompositionSchedule {
+  using Index = MultiIndex<Deps, Order>;
+
+  static_assert(Order <= SetPartitionsMaxOrder,
+                "CompositionSchedule: elementary functions of Variable need "
+                "Order <= SetPartitionsMaxOrder (8); any Deps is supported");
+
+  // 上限を超えたときに上の static_assert だけを出すため、表を作る次数を抑える
+  static constexpr size_t ORDER = std::min(Order, SetPartitionsMaxOrder);
+
+  using Partitions = SetPartitions<ORDER>;
+
+  static_assert(Index::SIZE <= UINT32_MAX);
+
+  static constexpr size_t count(size_t k) {
+    return Index::offset(k + 1) - Index::offset(k);
+  }
+
+  static constexpr size_t TERMS = [] {
+    size_t ret = 0;
+    for (size_t k = 1; k <= ORDER; k++) {
+      ret += count(k) * bell(k);
+    }
+    return ret;
+  }();
+
+  static constexpr size_t FACTORS = [] {
+    size_t ret = 0;
+    for (size_t k = 1; k <= ORDER; k++) {
+      for (auto p = Partitions::TABLE.start[k];
+           p < Partitions::TABLE.start[k + 1]; p++) {
+        ret += count(k) * Partitions::TABLE.blocks[p];
+      }
+    }
+    return ret;
+  }();
+
+  static constexpr bool CONSTEXPR_TABLE = FACTORS <= ScheduleConstexprTerms;
+
+  // コンパイル時に作る表
+  struct Table {
+    std::array<uint32_t, Index::SIZE + 1> start{};
+    std::array<uint32_t, TERMS + 1> factor_start{};
+    std::array<uint32_t, FACTORS> factor{};
+  };
+
+  // 実行時に作る表
+  struct HeapTable {
+    std::vector<uint32_t> start = std::vector<uint32_t>(Index::SIZE + 1);
+    std::vector<uint32_t> factor_start = std::vector<uint32_t>(TERMS + 1);
+    std::vector<uint32_t> factor = std::vector<uint32_t>(FACTORS);
+  };
+
+  template <class T> static constexpr void fill(T &ret) {
+    constexpr auto &partitions = Partitions::TABLE;
+    size_t t = 0;
+    size_t f = 0;
+    for (size_t n = 1, end = Index::offset(ORDER + 1); n < end; n++) {
+      const auto &idx = Index::TABLE[n];
+      const auto k = Index::degree(idx);
+      ret.start[n] = static_cast<uint32_t>(t);
+      for (auto p = partitions.start[k]; p < partitions.start[k + 1]; p++) {
+        ret.factor_start[t++] = static_cast<uint32_t>(f);
+        for (size_t b = 0; b < partitions.blocks[p]; b++) {
+          typename Index::Index block{};
+          for (size_t i = 0, nb = 0; i < k; i++) {
+            if (partitions.block[p][i] == b) {
+              block[nb++] = idx[i];
+            }
+          }
+          ret.factor[f++] = static_cast<uint32_t>(Index::rank(block));
+        }
+      }
+    }
+    ret.start[Index::SIZE] = static_cast<uint32_t>(t);
+    ret.factor_start[t] = static_cast<uint32_t>(f);
+  }
+
+  static HeapTable build_heap() {
+    HeapTable ret;
+    fill(ret);
+    return ret;
+  }
+
+  static constexpr Table TABLE = [] {
+    Table ret{};
+    fill(ret);
+    return ret;
+  }();
+
+  [[nodiscard]] static constexpr const auto &table() {
+    if constexpr (CONSTEXPR_TABLE) {
+      return TABLE;
+    } else {
+      static const HeapTable ret = build_heap();
+      return ret;
+    }
+  }
+};
+
+} // namespace Autodiff
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+
+#include "numeric.hpp"
+
+namespace Autodiff::detail {
+
+/*!
+ * 係数の漸化式で使う要素ごとの演算
+ *
+ * SingleVariable は ValType (入れ子の Numeric を含む) を、SingleVariableBatch は
+ * 評価点ごとの値を並べた std::array を要素にして、同じ漸化式を回す。
+ * c は一番内側の実数で、式の形と演算の順序は元の漸化式のままにしてある。
+ **/
+template <class T> struct SeriesElement {
+  using Real = RealOf<T>;
+
+  // acc += a b
+  static constexpr void add_mul(T &acc, const T &a, const T &b) {
+    acc += a * b;
+  }
+
+  // acc -= a b
+  static constexpr void sub_mul(T &acc, const T &a, const T &b) {
+    acc -= a * b;
+  }
+
+  // acc += c a b
+  static constexpr void add_mul(T &acc, Real c, const T &a, const T &b) {
+    acc += c * a * b;
+  }
+
+  // acc -= c a b
+  static constexpr void sub_mul(T &acc, Real c, const T &a, const T &b) {
+    acc -= c * a * b;
+  }
+
+  // acc *= x
+  static constexpr void mul(T &acc, const T &x) { acc *= x; }
+
+  // acc *= x / c
+  static constexpr void mul_div(T &acc, const T &x, Real c) { acc *= x / c; }
+
+  // acc /= c
+  static constexpr void div(T &acc, Real c) { acc /= c; }
+
+  // 同じ x で何度も割るための前処理 (スカラーはそのまま使う)
+  [[nodiscard]] static constexpr T divisor(const T &x) { return x; }
+
+  // acc /= c x (d = divisor(x))
+  static constexpr void div(T &acc, Real c, const T &d) { acc /= c * d; }
+
+  [[nodiscard]] static constexpr T scaled(Real c, const T &a) { return c * a; }
+
+  [[nodiscard]] static constexpr T inv(const T &a) { return Real{1} / a; }
+
+  [[nodiscard]] static constexpr T one() {
+    return NumericTraits<T>::constant(1);
+  }
+
+  // 足しても変わらない項を飛ばすため (入れ子で疎な係数が多いときに効く)
+  [[nodiscard]] static constexpr bool is_zero(const T &a) {
+    return NumericTraits<T>::is_zero(a);
+  }
+};
+
+// 評価点のループを最内にして、コンパイラの自動ベクトル化に任せる
+template <std::floating_point V, std::size_t W>
+struct SeriesElement<std::array<V, W>> {
+  using T = std::array<V, W>;
+  using Real = V;
+
+  static constexpr void add_mul(T &acc, const T &a, const T &b) {
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] += a[l] * b[l];
+    }
+  }
+
+  static constexpr void sub_mul(T &acc, const T &a, const T &b) {
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] -= a[l] * b[l];
+    }
+  }
+
+  static constexpr void add_mul(T &acc, Real c, const T &a, const T &b) {
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] += c * a[l] * b[l];
+    }
+  }
+
+  static constexpr void sub_mul(T &acc, Real c, const T &a, const T &b) {
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] -= c * a[l] * b[l];
+    }
+  }
+
+  static constexpr void mul(T &acc, const T &x) {
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] *= x[l];
+    }
+  }
+
+  // 割り算は評価点ごとに行わず、逆数を掛ける
+  static constexpr void mul_div(T &acc, const T &x, Real c) {
+    const auto inv_c = 1 / c;
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] *= x[l] * inv_c;
+    }
+  }
+
+  static constexpr void div(T &acc, Real c) {
+    const auto inv_c = 1 / c;
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] *= inv_c;
+    }
+  }
+
+  [[nodiscard]] static constexpr T divisor(const T &x) { return inv(x); }
+
+  static constexpr void div(T &acc, Real c, const T &d) {
+    const auto inv_c = 1 / c;
+    for (std::size_t l = 0; l < W; ++l) {
+      acc[l] *= d[l] * inv_c;
+    }
+  }
+
+  [[nodiscard]] static constexpr T scaled(Real c, const T &a) {
+    T ret{};
+    for (std::size_t l = 0; l < W; ++l) {
+      ret[l] = c * a[l];
+    }
+    return ret;
+  }
+
+  [[nodiscard]] static constexpr T inv(const T &a) {
+    T ret{};
+    for (std::size_t l = 0; l < W; ++l) {
+      ret[l] = Real{1} / a[l];
+    }
+    return ret;
+  }
+
+  [[nodiscard]] static constexpr T one() {
+    T ret{};
+    ret.fill(Real{1});
+    return ret;
+  }
+
+  // 評価点ごとに分岐すると自動ベクトル化できないので飛ばさない
+  [[nodiscard]] static constexpr bool is_zero(const T &) { return false; }
+};
+
+/*
+ * 以下の漸化式は正規化したテイラー係数 (f^(n) / n!) の配列に対して働く。
+ * r[0] (関数の値) は呼び出し側で入れておき、r の残りは 0 で渡す。
+ */
+
+// r = a b の先頭 N 項
+template <class T, std::size_t N>
+constexpr void series_mul(const std::array<T, N> &a, const std::array<T, N> &b,
+                          std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  for (std::size_t n = 0; n < N; ++n) {
+    for (std::size_t i = 0; i <= n; i++) {
+      E::add_mul(r[n], a[i], b[n - i]);
+    }
+  }
+}
+
+// r d = u より r_n = (u_n - Σ_{i=0}^{n-1} r_i d_{n-i}) / d_0 (r[0] も求める)
+template <class T, std::size_t N>
+constexpr void series_div(const std::array<T, N> &u, const std::array<T, N> &d,
+                          std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  const auto inv_value = E::inv(d[0]);
+  for (std::size_t n = 0; n < N; ++n) {
+    r[n] = u[n];
+    for (std::size_t i = 0; i < n; i++) {
+      E::sub_mul(r[n], r[i], d[n - i]);
+    }
+    E::mul(r[n], inv_value);
+  }
+}
+
+// r d = c (定数) の n >= 1 の項。r[0] = c / d_0 を入れておく
+template <class T, std::size_t N>
+constexpr void series_reciprocal(const std::array<T, N> &d,
+                                 std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  const auto inv_value = E::inv(d[0]);
+  for (std::size_t n = 1; n < N; ++n) {
+    for (std::size_t i = 0; i < n; i++) {
+      if (E::is_zero(d[n - i]) || E::is_zero(r[i])) {
+        continue;
+      }
+      E::sub_mul(r[n], r[i], d[n - i]);
+    }
+    E::mul(r[n], inv_value);
+  }
+}
+
+// r = u^p: r' u = p r u' より n r_n u_0 = Σ_{k=1}^{n} ((p + 1) k - n) u_k r_{n-k}
+template <class T, std::size_t N>
+constexpr void series_pow(const std::array<T, N> &u,
+                          typename SeriesElement<T>::Real p,
+                          std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  using Real = typename E::Real;
+  const auto inv_value = E::inv(u[0]);
+  for (std::size_t n = 1; n < N; ++n) {
+    for (std::size_t k = 1; k <= n; k++) {
+      E::add_mul(r[n],
+                 (p + 1) * static_cast<Real>(k) - static_cast<Real>(n), u[k],
+                 r[n - k]);
+    }
+    E::mul_div(r[n], inv_value, static_cast<Real>(n));
+  }
+}
+
+// r = exp u: r' = r u' より n r_n = Σ_{k=1}^{n} k u_k r_{n-k}
+template <class T, std::size_t N>
+constexpr void series_exp(const std::array<T, N> &u, std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  using Real = typename E::Real;
+  for (std::size_t n = 1; n < N; ++n) {
+    for (std::size_t k = 1; k <= n; k++) {
+      E::add_mul(r[n], static_cast<Real>(k), u[k], r[n - k]);
+    }
+    E::div(r[n], static_cast<Real>(n));
+  }
+}
+
+// r = log u: u r' = u' より n u_0 r_n = n u_n - Σ_{k=1}^{n-1} k r_k u_{n-k}
+template <class T, std::size_t N>
+constexpr void series_log(const std::array<T, N> &u, std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  using Real = typename E::Real;
+  const auto d = E::divisor(u[0]);
+  for (std::size_t n = 1; n < N; ++n) {
+    r[n] = E::scaled(static_cast<Real>(n), u[n]);
+    for (std::size_t k = 1; k < n; k++) {
+      E::sub_mul(r[n], static_cast<Real>(k), r[k], u[n - k]);
+    }
+    E::div(r[n], static_cast<Real>(n), d);
+  }
+}
+
+// s = sin u, c = cos u: sin' = cos u', cos' = -sin u' を連立させる
+template <class T, std::size_t N>
+constexpr void series_sincos(const std::array<T, N> &u, std::array<T, N> &s,
+                             std::array<T, N> &c) {
+  using E = SeriesElement<T>;
+  using Real = typename E::Real;
+  for (std::size_t n = 1; n < N; ++n) {
+    for (std::size_t k = 1; k <= n; k++) {
+      const auto uk = E::scaled(static_cast<Real>(k), u[k]);
+      E::add_mul(s[n], uk, c[n - k]);
+      E::sub_mul(c[n], uk, s[n - k]);
+    }
+    E::div(s[n], static_cast<Real>(n));
+    E::div(c[n], static_cast<Real>(n));
+  }
+}
+
+// r = tan u: tan' = (1 + tan^2) u' を w = 1 + tan^2 と連立させる
+template <class T, std::size_t N>
+constexpr void series_tan(const std::array<T, N> &u, std::array<T, N> &r) {
+  using E = SeriesElement<T>;
+  using Real = typename E::Real;
+  std::array<T, N> w{};
+  w[0] = E::one();
+  E::add_mul(w[0], r[0], r[0]);
+  for (std::size_t n = 1; n < N; ++n) {
+    for (std::size_t k = 1; k <= n; k++) {
+      E::add_mul(r[n], static_cast<Real>(k), u[k], w[n - k]);
+    }
+    E::div(r[n], static_cast<Real>(n));
+    for (std::size_t i = 0; i <= n; i++) {
+      E::add_mul(w[n], r[i], r[n - i]);
+    }
+  }
+}
+
+} // namespace Autodiff::detail
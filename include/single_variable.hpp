@@ -1,67 +1,392 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cinttypes>
-#include <complex>
+#include <cmath>
 #include <concepts>
 #include <iostream>
 #include <numbers>
+#include <utility>
+
+#include "numeric.hpp"
+#include "series.hpp"
 
 namespace Autodiff {
 
-constexpr std::array<std::array<double, 8>, 8> Combination{
-    {
-        {1, 0, 0, 0, 0, 0, 0, 0},
-        {1, 1, 0, 0, 0, 0, 0, 0},
-        {1, 2, 1, 0, 0, 0, 0, 0},
-        {1, 3, 3, 1, 0, 0, 0, 0},
-        {1, 4, 6, 4, 1, 0, 0, 0},
-        {1, 5, 10, 10, 5, 1, 0, 0},
-        {1, 6, 15, 20, 15, 6, 1, 0},
-        {1, 7, 21, 35, 35, 21, 7, 1},
-    },
-};
+/*!
+ * SeriesKaratsuba<Order> を true にした SingleVariable<Order> に限り、積を
+ * カラツバ法で、係数が SeriesNewtonThreshold 個以上なら逆数・exp・log を
+ * ニュートン法で求める。既定では使わず、積は先頭 Order + 1 項だけの筆算で求める。
+ *
+ * 精度に注意: カラツバ法は (a0 + a1)(b0 + b1) から a0 b0 と a1 b1 を引くので、
+ * どの係数にも積の最も大きい係数の丸め誤差が乗る。係数が n! で減る級数や
+ * 指数的に増える級数では小さい係数の相対誤差が大きく、exp(0.7t) exp(0.5t) の
+ * 128 項では n = 64 の係数がまったく合わない。係数の大きさが揃った級数
+ * (1 / (1 - t) の t = 0 での展開など) でだけ使う。
+ *
+ * ```cpp
+ * template <> inline constexpr bool Autodiff::SeriesKaratsuba<255> = true;
+ * ```
+ **/
+template <std::size_t Order> inline constexpr bool SeriesKaratsuba = false;
+
+// カラツバ法の再帰で、係数がこれより少ない積は筆算で求める
+inline constexpr std::size_t SeriesKaratsubaThreshold = 48;
+
+/*!
+ * SeriesKaratsuba を有効にしたとき、係数の数がこれ以上なら逆数・exp・log を
+ * ニュートン法で求める。定数倍が大きく、512 項までは漸化式の方が速い
+ **/
+inline constexpr std::size_t SeriesNewtonThreshold = 1024;
+
+namespace detail {
+
+// karatsuba(n) の作業領域の大きさ
+constexpr std::size_t karatsuba_work(std::size_t n) {
+  if (n < SeriesKaratsubaThreshold) {
+    return 0;
+  }
+  const auto k = n - n / 2;
+  return 4 * k - 1 + karatsuba_work(k);
+}
+
+// 長さ n の係数列 a, b の積 (長さ 2n - 1) を out に足す
+template <class T>
+constexpr void karatsuba(const T *a, const T *b, T *out, std::size_t n,
+                         T *work) {
+  if (n < SeriesKaratsubaThreshold) {
+    for (std::size_t i = 0; i < n; i++) {
+      for (std::size_t j = 0; j < n; j++) {
+        out[i + j] += a[i] * b[j];
+      }
+    }
+    return;
+  }
+  // a = a0 + a1 x^h として (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 を中央に足す
+  const auto h = n / 2;
+  const auto k = n - h;
+  auto *z = work;
+  auto *sa = z + 2 * k - 1;
+  auto *sb = sa + k;
+  auto *rest = sb + k;
+
+  std::fill_n(z, 2 * h - 1, T{});
+  karatsuba(a, b, z, h, rest);
+  for (std::size_t i = 0; i < 2 * h - 1; i++) {
+    out[i] += z[i];
+    out[h + i] -= z[i];
+  }
+  std::fill_n(z, 2 * k - 1, T{});
+  karatsuba(a + h, b + h, z, k, rest);
+  for (std::size_t i = 0; i < 2 * k - 1; i++) {
+    out[2 * h + i] += z[i];
+    out[h + i] -= z[i];
+  }
+  for (std::size_t i = 0; i < k; i++) {
+    sa[i] = a[h + i];
+    sb[i] = b[h + i];
+  }
+  for (std::size_t i = 0; i < h; i++) {
+    sa[i] += a[i];
+    sb[i] += b[i];
+  }
+  std::fill_n(z, 2 * k - 1, T{});
+  karatsuba(sa, sb, z, k, rest);
+  for (std::size_t i = 0; i < 2 * k - 1; i++) {
+    out[h + i] += z[i];
+  }
+}
+
+// short_product(m) の作業領域の大きさ
+constexpr std::size_t short_product_work(std::size_t m) {
+  if (m < SeriesKaratsubaThreshold) {
+    return 0;
+  }
+  const auto h = m - m / 2;
+  return std::max(2 * h - 1 + karatsuba_work(h), short_product_work(m - h));
+}
+
+// 長さ m の係数列 a, b の積の先頭 m 項を out に足す (残りの項は求めない)
+template <class T>
+constexpr void short_product(const T *a, const T *b, T *out, std::size_t m,
+                             T *work) {
+  if (m < SeriesKaratsubaThreshold) {
+    for (std::size_t n = 0; n < m; n++) {
+      for (std::size_t i = 0; i <= n; i++) {
+        out[n] += a[i] * b[n - i];
+      }
+    }
+    return;
+  }
+  // a = a0 + a1 x^h として a0 b0 + (a1 b0 + a0 b1) x^h の先頭 m 項
+  const auto h = m - m / 2;
+  const auto l = m - h;
+  std::fill_n(work, 2 * h - 1, T{});
+  karatsuba(a, b, work, h, work + 2 * h - 1);
+  for (std::size_t i = 0; i < std::min(m, 2 * h - 1); i++) {
+    out[i] += work[i];
+  }
+  short_product(a + h, b, out + h, l, work);
+  short_product(a, b + h, out + h, l, work);
+}
+
+} // namespace detail
 
 template <size_t N>
 using Value = std::tuple<size_t, std::array<size_t, N>, size_t>;
 
 /*!
  * 変数が一つの自動微分
+ *
+ * values[n] には n 階微分ではなく正規化したテイラー係数 f^(n) / n! を持つ。
+ * 畳み込みに二項係数が要らず、Order に上限もない。
+ * コンストラクタ, operator[], get_value, set_value, derivative は微分係数を、
+ * coefficient, set_coefficient, from_coefficients はこの係数をそのまま扱う。
+ * ValType は Numeric なら何でもよく、SingleVariable や Variable を入れ子にすると
+ * 別の方向の微分を重ねて持てる。
  **/
-template <std::size_t Order, std::floating_point ValType = double>
-class SingleVariable {
+template <std::size_t Order, Numeric ValType = double>
+class SingleVariable
+    : public RealScalarOps<SingleVariable<Order, ValType>, ValType> {
+  friend RealScalarOps<SingleVariable, ValType>;
+
+public:
+  using Real = RealOf<ValType>;
+
 private:
-  std::array<ValType, Order + 1> values{};
+  using Coeffs = std::array<ValType, Order + 1>;
+
+  static constexpr bool KARATSUBA =
+      SeriesKaratsuba<Order> && Order + 1 >= SeriesKaratsubaThreshold;
+  static constexpr bool NEWTON =
+      SeriesKaratsuba<Order> && Order + 1 >= SeriesNewtonThreshold;
+
+  Coeffs values{};
+
+  [[nodiscard]] constexpr Coeffs &coeffs() { return values; }
+
+  // a, b の先頭 m 項の積の先頭 m 項
+  [[nodiscard]] static constexpr Coeffs
+  product(const Coeffs &a, const Coeffs &b, std::size_t m = Order + 1) {
+    Coeffs ret{};
+    std::array<ValType, detail::short_product_work(Order + 1)> work{};
+    detail::short_product(a.data(), b.data(), ret.data(), m, work.data());
+    return ret;
+  }
+
+  // 先頭 m 項の逆数 (g <- g (2 - f g) で正しい項数を倍々にする)
+  [[nodiscard]] static constexpr Coeffs newton_inv(const Coeffs &f,
+                                                   std::size_t m = Order + 1) {
+    Coeffs g{};
+    g[0] = Real{1} / f[0];
+    for (std::size_t k = 1; k < m;) {
+      k = std::min(2 * k, m);
+      auto t = product(f, g, k);
+      for (std::size_t i = 0; i < k; i++) {
+        t[i] = -t[i];
+      }
+      t[0] += 2;
+      g = product(g, t, k);
+    }
+    return g;
+  }
+
+  // 先頭 m 項の log (log f = log f_0 + ∫ f' / f)
+  [[nodiscard]] static constexpr Coeffs newton_log(const Coeffs &f,
+                                                   std::size_t m = Order + 1) {
+    Coeffs df{};
+    for (std::size_t k = 0; k + 1 < m; k++) {
+      df[k] = static_cast<Real>(k + 1) * f[k + 1];
+    }
+    const auto q = product(df, newton_inv(f, m - 1), m - 1);
+    Coeffs ret{};
+    ret[0] = Math::log(f[0]);
+    for (std::size_t k = 1; k < m; k++) {
+      ret[k] = q[k - 1] / static_cast<Real>(k);
+    }
+    return ret;
+  }
+
+  // exp (g <- g (1 + f - log g) で正しい項数を倍々にする)
+  [[nodiscard]] static constexpr Coeffs newton_exp(const Coeffs &f) {
+    Coeffs g{};
+    g[0] = Math::exp(f[0]);
+    for (std::size_t k = 1; k < Order + 1;) {
+      k = std::min(2 * k, Order + 1);
+      auto h = newton_log(g, k);
+      for (std::size_t i = 0; i < k; i++) {
+        h[i] = f[i] - h[i];
+      }
+      h[0] += 1;
+      g = product(g, h, k);
+    }
+    return g;
+  }
+
+  // d r' = u' を r について解く (n d_0 r_n = n u_n - Σ_{k=1}^{n-1} k r_k d_{n-k})
+  [[nodiscard]] static constexpr SingleVariable
+  solve_derivative(const SingleVariable &u, const SingleVariable &d) {
+    SingleVariable result{};
+    for (std::size_t n = 1; n < Order + 1; ++n) {
+      result.values[n] = static_cast<Real>(n) * u.values[n];
+      for (std::size_t k = 1; k < n; k++) {
+        result.values[n] -=
+            static_cast<Real>(k) * result.values[k] * d.values[n - k];
+      }
+      result.values[n] /= static_cast<Real>(n) * d.values[0];
+    }
+    return result;
+  }
 
 public:
   SingleVariable() = default;
 
   explicit constexpr SingleVariable(ValType value) {
     this->values[0] = value;
-    this->values[1] = 1.0;
+    this->values[1] = NumericTraits<ValType>::constant(1);
   }
 
+  // values[n] に n 階微分を並べたもの
   explicit constexpr SingleVariable(std::array<ValType, Order + 1> values)
-      : values(values) {}
+      : values(values) {
+    for (std::size_t n = 2; n < Order + 1; n++) {
+      this->values[n] /= factorial(n);
+    }
+  }
 
+  // 正規化したテイラー係数を並べたもの
+  [[nodiscard]] static constexpr SingleVariable
+  from_coefficients(const std::array<ValType, Order + 1> &coefficients) {
+    SingleVariable ret;
+    ret.values = coefficients;
+    return ret;
+  }
+
+  // index 階微分を value にする
   void constexpr set_value(ValType value, size_t index = 0) {
     assert(index <= Order);
-    this->values[index] = value;
+    this->values[index] = value / factorial(index);
   }
 
-  [[nodiscard]] constexpr ValType &operator[](size_t index) {
-    return this->values[index];
+  // index 階微分
+  [[nodiscard]] constexpr ValType get_value(size_t index) const {
+    return this->derivative(index);
   }
 
-  [[nodiscard]] constexpr ValType get_value(size_t index) const {
-    return this->values[index];
+  /*!
+   * 代入すると index 階微分を書き換える参照
+   * 係数は正規化して持つので ValType & は取れない (auto で受けるか、
+   * 値が要るときは ValType に変換する)
+   **/
+  class Reference {
+    SingleVariable &self;
+    size_t index;
+
+  public:
+    constexpr Reference(SingleVariable &self, size_t index)
+        : self(self), index(index) {}
+
+    constexpr Reference(const Reference &) = default;
+
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    constexpr operator ValType() const { return self.get_value(index); }
+
+    constexpr Reference &operator=(const ValType &value) {
+      self.set_value(value, index);
+      return *this;
+    }
+
+    // sv[i] = sv[j] は参照先ではなく値を代入する
+    constexpr Reference &operator=(const Reference &other) {
+      return *this = static_cast<ValType>(other);
+    }
+
+    constexpr Reference &operator+=(const ValType &value) {
+      return *this = static_cast<ValType>(*this) + value;
+    }
+
+    constexpr Reference &operator-=(const ValType &value) {
+      return *this = static_cast<ValType>(*this) - value;
+    }
+
+    constexpr Reference &operator*=(const ValType &value) {
+      return *this = static_cast<ValType>(*this) * value;
+    }
+
+    constexpr Reference &operator/=(const ValType &value) {
+      return *this = static_cast<ValType>(*this) / value;
+    }
+  };
+
+  [[nodiscard]] constexpr Reference operator[](size_t index) {
+    return Reference(*this, index);
   }
 
   [[nodiscard]] constexpr ValType operator[](size_t index) const {
     return this->get_value(index);
   }
 
+  // 正規化したテイラー係数 f^(n) / n!
+  [[nodiscard]] constexpr const ValType &coefficient(size_t n) const {
+    return this->values[n];
+  }
+
+  constexpr void set_coefficient(size_t n, ValType value) {
+    assert(n <= Order);
+    this->values[n] = value;
+  }
+
+  constexpr SingleVariable &operator+=(const SingleVariable &rhs) {
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      this->values[i] += rhs.values[i];
+    }
+    return *this;
+  }
+
+  constexpr SingleVariable &operator+=(const ValType &rhs) {
+    this->values[0] += rhs;
+    return *this;
+  }
+
+  constexpr SingleVariable &operator-=(const SingleVariable &rhs) {
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      this->values[i] -= rhs.values[i];
+    }
+    return *this;
+  }
+
+  constexpr SingleVariable &operator-=(const ValType &rhs) {
+    this->values[0] -= rhs;
+    return *this;
+  }
+
+  constexpr SingleVariable &operator*=(const SingleVariable &rhs) {
+    return *this = *this * rhs;
+  }
+
+  constexpr SingleVariable &operator*=(const ValType &rhs) {
+    for (auto &&v : this->values) {
+      v *= rhs;
+    }
+    return *this;
+  }
+
+  constexpr SingleVariable &operator/=(const SingleVariable &rhs) {
+    return *this = *this / rhs;
+  }
+
+  constexpr SingleVariable &operator/=(const ValType &rhs) {
+    return *this *= Real{1} / rhs;
+  }
+
+  // 入れ子のときの Real との複合代入
+  using RealScalarOps<SingleVariable, ValType>::operator+=;
+  using RealScalarOps<SingleVariable, ValType>::operator-=;
+  using RealScalarOps<SingleVariable, ValType>::operator*=;
+  using RealScalarOps<SingleVariable, ValType>::operator/=;
+
   [[nodiscard]] constexpr SingleVariable
   operator+(const SingleVariable &rhs) const {
     SingleVariable result{};
@@ -116,14 +441,11 @@ public:
 
   [[nodiscard]] constexpr SingleVariable
   operator*(const SingleVariable &rhs) const {
-    SingleVariable result{};
-    result.values[0] = this->values[0] * rhs.values[0];
-    for (std::size_t n = 1; n < Order + 1; ++n) {
-      for (std::size_t i = 0; i <= n; i++) {
-        result.values[n] +=
-            Combination[n][i] * this->values[i] * rhs.values[n - i];
-      }
+    if constexpr (KARATSUBA) {
+      return from_coefficients(product(this->values, rhs.values));
     }
+    SingleVariable result{};
+    detail::series_mul(this->values, rhs.values, result.values);
     return result;
   }
 
@@ -147,80 +469,138 @@ public:
   }
 
   [[nodiscard]] constexpr SingleVariable inv() const {
+    return Real{1} / *this;
+  }
+
+  [[nodiscard]] constexpr SingleVariable
+  operator/(const SingleVariable &rhs) const {
+    if constexpr (NEWTON) {
+      return from_coefficients(product(this->values, newton_inv(rhs.values)));
+    }
     SingleVariable result{};
-    result.values[0] = 1. / this->values[0];
-    for (std::size_t n = 1; n < Order + 1; ++n) {
-      result.values[n] = -this->values[n] * result.values[0];
-      for (std::size_t i = 1; i < n; i++) {
-        if (this->values[n - i] == 0. || result.values[i] == 0.) {
-          continue;
-        }
-        result.values[n] -=
-            Combination[n][i] * result.values[i] * this->values[n - i];
+    detail::series_div(this->values, rhs.values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariable operator/(const ValType &rhs) const {
+    return *this * (Real{1} / rhs);
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  operator/(const ValType &lhs, const SingleVariable &rhs) {
+    if constexpr (NEWTON) {
+      return lhs * from_coefficients(newton_inv(rhs.values));
+    }
+    SingleVariable result{};
+    result.values[0] = lhs * (Real{1} / rhs.values[0]);
+    detail::series_reciprocal(rhs.values, result.values);
+    return result;
+  }
+
+  // r' u = p r u' より n r_n u_0 = Σ_{k=1}^{n} ((p + 1) k - n) u_k r_{n-k}
+  [[nodiscard]] constexpr SingleVariable pow(const Real &rhs) const {
+    if constexpr (NEWTON) {
+      // u^p = u_0^p exp(p log(u / u_0))
+      auto l = newton_log((*this / this->values[0]).values);
+      for (auto &&v : l) {
+        v *= rhs;
       }
-      result.values[n] *= result.values[0];
+      return Math::pow(this->values[0], rhs) * from_coefficients(newton_exp(l));
     }
+    SingleVariable result{};
+    result.values[0] = Math::pow(this->values[0], rhs);
+    detail::series_pow(this->values, rhs, result.values);
     return result;
   }
 
+  [[nodiscard]] friend constexpr SingleVariable pow(const SingleVariable &self,
+                                                    const Real &rhs) {
+    return self.pow(rhs);
+  }
+
+  // u^v = exp(v log u) を log u, v log u と同時に一回の漸化式で求める
   [[nodiscard]] constexpr SingleVariable
-  operator/(const SingleVariable &rhs) const {
+  pow(const SingleVariable &rhs) const {
     SingleVariable result{};
-    auto inv_value = 1. / rhs.values[0];
-    result.values[0] = this->values[0] * inv_value;
+    Coeffs l{};
+    Coeffs w{};
+    l[0] = Math::log(this->values[0]);
+    w[0] = rhs.values[0] * l[0];
+    result.values[0] = Math::pow(this->values[0], rhs.values[0]);
+    ValType inv_value = Real{1} / this->values[0];
     for (std::size_t n = 1; n < Order + 1; ++n) {
-      result.values[n] = this->values[n] * inv_value;
-      for (std::size_t i = 0; i < n; i++) {
-        result.values[n] -= Combination[n][i] * result.values[i] *
-                            rhs.values[n - i] * inv_value;
+      l[n] = static_cast<Real>(n) * this->values[n];
+      for (std::size_t k = 1; k < n; k++) {
+        l[n] -= static_cast<Real>(k) * l[k] * this->values[n - k];
+      }
+      l[n] *= inv_value / static_cast<Real>(n);
+      for (std::size_t i = 0; i <= n; i++) {
+        w[n] += rhs.values[i] * l[n - i];
       }
+      for (std::size_t k = 1; k <= n; k++) {
+        result.values[n] +=
+            static_cast<Real>(k) * w[k] * result.values[n - k];
+      }
+      result.values[n] /= static_cast<Real>(n);
     }
     return result;
   }
 
-  [[nodiscard]] constexpr SingleVariable operator/(const ValType &rhs) const {
-    return *this * (1. / rhs);
+  [[nodiscard]] friend constexpr SingleVariable
+  pow(const SingleVariable &self, const SingleVariable &rhs) {
+    return self.pow(rhs);
   }
 
-  [[nodiscard]] friend constexpr SingleVariable
-  operator/(const ValType &lhs, const SingleVariable &rhs) {
+  /*!
+   * d = x^2 + y^2 として d θ' = x y' - y x' から
+   * n d_0 θ_n = Σ_{k=1}^{n} k (x_{n-k} y_k - y_{n-k} x_k)
+   *             - Σ_{k=1}^{n-1} k θ_k d_{n-k}
+   **/
+  [[nodiscard]] friend constexpr SingleVariable atan2(const SingleVariable &y,
+                                                      const SingleVariable &x) {
     SingleVariable result{};
-    result.values[0] = lhs / rhs.values[0];
+    Coeffs d{};
+    result.values[0] = Math::atan2(y.values[0], x.values[0]);
+    d[0] = x.values[0] * x.values[0] + y.values[0] * y.values[0];
     for (std::size_t n = 1; n < Order + 1; ++n) {
-      result.values[n] = -rhs.values[n] * result.values[0];
-      for (std::size_t i = 1; i < n; i++) {
-        if (rhs.values[n - i] == 0. || result.values[i] == 0.) {
-          continue;
-        }
+      for (std::size_t k = 1; k <= n; k++) {
+        result.values[n] += static_cast<Real>(k) *
+                            (x.values[n - k] * y.values[k] -
+                             y.values[n - k] * x.values[k]);
+      }
+      for (std::size_t k = 1; k < n; k++) {
         result.values[n] -=
-            Combination[n][i] * result.values[i] * rhs.values[n - i];
+            static_cast<Real>(k) * result.values[k] * d[n - k];
+      }
+      result.values[n] /= static_cast<Real>(n) * d[0];
+      for (std::size_t i = 0; i <= n; i++) {
+        d[n] += x.values[i] * x.values[n - i] + y.values[i] * y.values[n - i];
       }
-      result.values[n] *= result.values[0];
     }
     return result;
   }
 
-  [[nodiscard]] constexpr SingleVariable pow(const ValType &rhs) const {
+  // h^2 = x^2 + y^2 を h について解く (sqrt と同じく h_0 で割る)
+  [[nodiscard]] friend constexpr SingleVariable hypot(const SingleVariable &x,
+                                                      const SingleVariable &y) {
     SingleVariable result{};
-    result.values[0] = std::pow(this->values[0], rhs);
-    ValType inv_value = 1 / this->values[0];
-    for (std::size_t n = 1; n <= Order; ++n) {
-      for (std::size_t i = 0; i < n; i++) {
+    result.values[0] = Math::hypot(x.values[0], y.values[0]);
+    ValType inv_value = Real{1} / (2 * result.values[0]);
+    for (std::size_t n = 1; n < Order + 1; ++n) {
+      for (std::size_t i = 0; i <= n; i++) {
         result.values[n] +=
-            (Combination[n - 1][i] * (rhs + 1) - Combination[n][i]) *
-            this->values[n - i] * result.values[i] * inv_value;
+            x.values[i] * x.values[n - i] + y.values[i] * y.values[n - i];
+      }
+      for (std::size_t i = 1; i < n; i++) {
+        result.values[n] -= result.values[i] * result.values[n - i];
       }
+      result.values[n] *= inv_value;
     }
     return result;
   }
 
-  [[nodiscard]] friend constexpr SingleVariable pow(const SingleVariable &self,
-                                                    const ValType &rhs) {
-    return self.pow(rhs);
-  }
-
   [[nodiscard]] constexpr SingleVariable sqrt() const {
-    return this->pow(1. / 2);
+    return this->pow(Real{1} / 2);
   }
 
   [[nodiscard]] friend constexpr SingleVariable
@@ -229,7 +609,7 @@ public:
   }
 
   [[nodiscard]] constexpr SingleVariable cbrt() const {
-    return this->pow(1. / 3);
+    return this->pow(Real{1} / 3);
   }
 
   [[nodiscard]] friend constexpr SingleVariable
@@ -237,15 +617,14 @@ public:
     return self.cbrt();
   }
 
+  // r' = r u' より n r_n = Σ_{k=1}^{n} k u_k r_{n-k}
   [[nodiscard]] constexpr SingleVariable exp() const {
-    SingleVariable result{};
-    result.values[0] = std::exp(this->values[0]);
-    for (std::size_t n = 1; n < Order + 1; ++n) {
-      for (std::size_t i = 0; i < n; i++) {
-        result.values[n] +=
-            Combination[n - 1][i] * this->values[n - i] * result.values[i];
-      }
+    if constexpr (NEWTON) {
+      return from_coefficients(newton_exp(this->values));
     }
+    SingleVariable result{};
+    result.values[0] = Math::exp(this->values[0]);
+    detail::series_exp(this->values, result.values);
     return result;
   }
 
@@ -254,17 +633,14 @@ public:
     return self.exp();
   }
 
+  // u r' = u' より n u_0 r_n = n u_n - Σ_{k=1}^{n-1} k r_k u_{n-k}
   [[nodiscard]] constexpr SingleVariable log() const {
-    SingleVariable result{};
-    result.values[0] = std::log(this->values[0]);
-    for (std::size_t n = 1; n < Order + 1; ++n) {
-      result.values[n] = this->values[n];
-      for (std::size_t i = 1; i < n; i++) {
-        result.values[n] -=
-            Combination[n - 1][i - 1] * result.values[i] * this->values[n - i];
-      }
-      result.values[n] /= this->values[0];
+    if constexpr (NEWTON) {
+      return from_coefficients(newton_log(this->values));
     }
+    SingleVariable result{};
+    result.values[0] = Math::log(this->values[0]);
+    detail::series_log(this->values, result.values);
     return result;
   }
 
@@ -273,21 +649,27 @@ public:
     return self.log();
   }
 
+  /*!
+   * sin と cos を同時に求める
+   * sin' = cos u', cos' = -sin u' を連立させた漸化式
+   **/
+  [[nodiscard]] constexpr std::pair<SingleVariable, SingleVariable>
+  sincos() const {
+    SingleVariable s{};
+    SingleVariable c{};
+    s.values[0] = Math::sin(this->values[0]);
+    c.values[0] = Math::cos(this->values[0]);
+    detail::series_sincos(this->values, s.values, c.values);
+    return {s, c};
+  }
+
+  [[nodiscard]] friend constexpr std::pair<SingleVariable, SingleVariable>
+  sincos(const SingleVariable &self) {
+    return self.sincos();
+  }
+
   [[nodiscard]] constexpr SingleVariable sin() const {
-    SingleVariable result{};
-    std::array<std::complex<ValType>, Order + 1> complex_values;
-    complex_values[0] = std::exp(std::complex<ValType>(0, this->values[0]));
-    for (std::size_t n = 1; n < Order + 1; ++n) {
-      for (std::size_t i = 0; i < n; i++) {
-        complex_values[n] += std::complex<ValType>(0., 1.) *
-                             Combination[n - 1][i] * this->values[n - i] *
-                             complex_values[i];
-      }
-    }
-    for (std::size_t i = 0; i < Order + 1; i++) {
-      result.values[i] = std::imag(complex_values[i]);
-    }
-    return result;
+    return this->sincos().first;
   }
 
   [[nodiscard]] friend constexpr SingleVariable
@@ -296,55 +678,211 @@ public:
   }
 
   [[nodiscard]] constexpr SingleVariable cos() const {
+    return this->sincos().second;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  cos(const SingleVariable &self) {
+    return self.cos();
+  }
+
+  // tan' = (1 + tan^2) u' を w = 1 + tan^2 と連立させた漸化式
+  [[nodiscard]] constexpr SingleVariable tan() const {
+    SingleVariable result{};
+    result.values[0] = Math::tan(this->values[0]);
+    detail::series_tan(this->values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  tan(const SingleVariable &self) {
+    return self.tan();
+  }
+
+  // sqrt(1 - u^2) asin' = u'
+  [[nodiscard]] constexpr SingleVariable asin() const {
+    auto result = solve_derivative(*this, (1 - *this * *this).sqrt());
+    result.values[0] = Math::asin(this->values[0]);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  asin(const SingleVariable &self) {
+    return self.asin();
+  }
+
+  // (1 + u^2) atan' = u'
+  [[nodiscard]] constexpr SingleVariable atan() const {
+    auto result = solve_derivative(*this, 1 + *this * *this);
+    result.values[0] = Math::atan(this->values[0]);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  atan(const SingleVariable &self) {
+    return self.atan();
+  }
+
+  // (1 + u) log1p' = u'
+  [[nodiscard]] constexpr SingleVariable log1p() const {
+    auto result = solve_derivative(*this, 1 + *this);
+    result.values[0] = Math::log1p(this->values[0]);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  log1p(const SingleVariable &self) {
+    return self.log1p();
+  }
+
+  // expm1' = (expm1 + 1) u' (値だけ std::expm1 で精度を保つ)
+  [[nodiscard]] constexpr SingleVariable expm1() const {
     SingleVariable result{};
-    std::array<std::complex<ValType>, Order + 1> complex_values;
-    complex_values[0] = std::exp(std::complex<ValType>(0, this->values[0]));
+    result.values[0] = Math::expm1(this->values[0]);
     for (std::size_t n = 1; n < Order + 1; ++n) {
-      for (std::size_t i = 0; i < n; i++) {
-        complex_values[n] += std::complex<ValType>(0., 1.) *
-                             Combination[n - 1][i] * this->values[n - i] *
-                             complex_values[i];
+      result.values[n] = static_cast<Real>(n) * this->values[n];
+      for (std::size_t k = 1; k <= n; k++) {
+        result.values[n] += static_cast<Real>(k) * this->values[k] *
+                            result.values[n - k];
       }
-    }
-    for (std::size_t i = 0; i < Order + 1; i++) {
-      result.values[i] = std::real(complex_values[i]);
+      result.values[n] /= static_cast<Real>(n);
     }
     return result;
   }
 
   [[nodiscard]] friend constexpr SingleVariable
-  cos(const SingleVariable &self) {
-    return self.cos();
+  expm1(const SingleVariable &self) {
+    return self.expm1();
   }
 
-  [[nodiscard]] constexpr SingleVariable tan() const {
-    SingleVariable nume{};
-    SingleVariable deno{};
-    std::array<std::complex<ValType>, Order + 1> complex_values;
-    complex_values[0] = std::exp(std::complex<ValType>(0, this->values[0]));
+  // sinh' = cosh u', cosh' = sinh u' を連立させた漸化式
+  [[nodiscard]] constexpr std::pair<SingleVariable, SingleVariable>
+  sinhcosh() const {
+    SingleVariable s{};
+    SingleVariable c{};
+    s.values[0] = Math::sinh(this->values[0]);
+    c.values[0] = Math::cosh(this->values[0]);
     for (std::size_t n = 1; n < Order + 1; ++n) {
-      for (std::size_t i = 0; i < n; i++) {
-        complex_values[n] += std::complex<ValType>(0., 1.) *
-                             Combination[n - 1][i] * this->values[n - i] *
-                             complex_values[i];
+      for (std::size_t k = 1; k <= n; k++) {
+        const auto u = static_cast<Real>(k) * this->values[k];
+        s.values[n] += u * c.values[n - k];
+        c.values[n] += u * s.values[n - k];
       }
+      s.values[n] /= static_cast<Real>(n);
+      c.values[n] /= static_cast<Real>(n);
     }
-    for (std::size_t i = 0; i < Order + 1; i++) {
-      nume.values[i] = std::imag(complex_values[i]);
+    return {s, c};
+  }
+
+  [[nodiscard]] constexpr SingleVariable sinh() const {
+    return this->sinhcosh().first;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  sinh(const SingleVariable &self) {
+    return self.sinh();
+  }
+
+  [[nodiscard]] constexpr SingleVariable cosh() const {
+    return this->sinhcosh().second;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  cosh(const SingleVariable &self) {
+    return self.cosh();
+  }
+
+  // tanh' = (1 - tanh^2) u' を w = 1 - tanh^2 と連立させた漸化式
+  [[nodiscard]] constexpr SingleVariable tanh() const {
+    SingleVariable result{};
+    Coeffs w{};
+    result.values[0] = Math::tanh(this->values[0]);
+    w[0] = 1 - result.values[0] * result.values[0];
+    for (std::size_t n = 1; n < Order + 1; ++n) {
+      for (std::size_t k = 1; k <= n; k++) {
+        result.values[n] +=
+            static_cast<Real>(k) * this->values[k] * w[n - k];
+      }
+      result.values[n] /= static_cast<Real>(n);
+      for (std::size_t i = 0; i <= n; i++) {
+        w[n] -= result.values[i] * result.values[n - i];
+      }
     }
-    for (std::size_t i = 0; i < Order + 1; i++) {
-      deno.values[i] = std::real(complex_values[i]);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariable
+  tanh(const SingleVariable &self) {
+    return self.tanh();
+  }
+
+  /*!
+   * erf' = 2 / √π g u', g = exp(q), q = -u^2 として
+   * g' = g q' と連立させた漸化式
+   **/
+  [[nodiscard]] constexpr SingleVariable erf() const {
+    SingleVariable result{};
+    Coeffs q{};
+    Coeffs g{};
+    result.values[0] = Math::erf(this->values[0]);
+    q[0] = -this->values[0] * this->values[0];
+    g[0] = 2 * std::numbers::inv_sqrtpi_v<Real> * Math::exp(q[0]);
+    for (std::size_t n = 1; n < Order + 1; ++n) {
+      for (std::size_t i = 0; i <= n; i++) {
+        q[n] -= this->values[i] * this->values[n - i];
+      }
+      for (std::size_t k = 1; k <= n; k++) {
+        result.values[n] +=
+            static_cast<Real>(k) * this->values[k] * g[n - k];
+        g[n] += static_cast<Real>(k) * q[k] * g[n - k];
+      }
+      result.values[n] /= static_cast<Real>(n);
+      g[n] /= static_cast<Real>(n);
     }
-    return nume / deno;
+    return result;
   }
 
   [[nodiscard]] friend constexpr SingleVariable
-  tan(const SingleVariable &self) {
-    return self.tan();
+  erf(const SingleVariable &self) {
+    return self.erf();
   }
 
+  // order 階微分 (係数に order! を掛けて戻す)
   [[nodiscard]] constexpr ValType derivative(std::size_t order) const {
-    return this->values.at(order);
+    auto ret = this->values.at(order);
+    ret *= factorial(order);
+    return ret;
+  }
+
+private:
+  [[nodiscard]] static constexpr Real factorial(std::size_t n) {
+    Real ret{1};
+    for (std::size_t i = 2; i <= n; i++) {
+      ret *= static_cast<Real>(i);
+    }
+    return ret;
+  }
+};
+
+template <std::size_t Order, Numeric ValType>
+struct NumericTraits<SingleVariable<Order, ValType>> {
+  using Real = RealOf<ValType>;
+
+  [[nodiscard]] static constexpr SingleVariable<Order, ValType>
+  constant(Real value) {
+    SingleVariable<Order, ValType> ret{};
+    ret.set_value(NumericTraits<ValType>::constant(value));
+    return ret;
+  }
+
+  [[nodiscard]] static constexpr bool
+  is_zero(const SingleVariable<Order, ValType> &value) {
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      if (!NumericTraits<ValType>::is_zero(value.coefficient(i))) {
+        return false;
+      }
+    }
+    return true;
   }
 };
 
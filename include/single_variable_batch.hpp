@@ -0,0 +1,308 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <utility>
+
+#include "series.hpp"
+#include "single_variable.hpp"
+
+namespace Autodiff {
+
+/*!
+ * Width 個の評価点での SingleVariable をまとめて扱う
+ *
+ * 係数は階数ごとに Width 個の値を並べた構造体配列 (SoA) で持ち、
+ * すべての演算で評価点のループを最内にしてコンパイラの自動ベクトル化
+ * (AVX2 / AVX-512 など) に任せる。係数の持ち方 (正規化したテイラー係数) と
+ * 漸化式は SingleVariable と同じで、漸化式は series.hpp のものを
+ * 評価点の配列を要素として呼ぶ。
+ **/
+template <std::size_t Order, std::floating_point ValType = double,
+          std::size_t Width = 8>
+class SingleVariableBatch {
+public:
+  using Lanes = std::array<ValType, Width>;
+
+private:
+  alignas(sizeof(Lanes) % 64 == 0 ? 64 : alignof(Lanes))
+      std::array<Lanes, Order + 1> values{};
+
+  template <class F> static constexpr Lanes map(const Lanes &x, F &&f) {
+    Lanes ret{};
+    for (std::size_t l = 0; l < Width; ++l) {
+      ret[l] = f(x[l]);
+    }
+    return ret;
+  }
+
+public:
+  SingleVariableBatch() = default;
+
+  // 各評価点 value[l] での独立変数
+  explicit constexpr SingleVariableBatch(const Lanes &value) {
+    this->values[0] = value;
+    this->values[1].fill(1.0);
+  }
+
+  // 各評価点の index 階微分を value にする
+  void constexpr set_value(const Lanes &value, std::size_t index = 0) {
+    assert(index <= Order);
+    const auto inv = 1 / factorial(index);
+    this->values[index] = map(value, [inv](ValType v) { return v * inv; });
+  }
+
+  // 各評価点の index 階微分
+  [[nodiscard]] constexpr Lanes get_value(std::size_t index) const {
+    const auto f = factorial(index);
+    return map(this->values[index], [f](ValType v) { return v * f; });
+  }
+
+  // 正規化したテイラー係数 f^(n) / n!
+  [[nodiscard]] constexpr const Lanes &coefficient(std::size_t n) const {
+    return this->values[n];
+  }
+
+  void constexpr set_coefficient(std::size_t n, const Lanes &value) {
+    assert(n <= Order);
+    this->values[n] = value;
+  }
+
+  // 評価点 lane の SingleVariable を取り出す
+  [[nodiscard]] constexpr SingleVariable<Order, ValType>
+  lane(std::size_t lane) const {
+    SingleVariable<Order, ValType> ret{};
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      ret.set_coefficient(i, this->values[i][lane]);
+    }
+    return ret;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator+(const SingleVariableBatch &rhs) const {
+    SingleVariableBatch result{};
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      for (std::size_t l = 0; l < Width; ++l) {
+        result.values[i][l] = this->values[i][l] + rhs.values[i][l];
+      }
+    }
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator+(const ValType &rhs) const {
+    SingleVariableBatch result{*this};
+    for (std::size_t l = 0; l < Width; ++l) {
+      result.values[0][l] += rhs;
+    }
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  operator+(const ValType &lhs, const SingleVariableBatch &rhs) {
+    return rhs + lhs;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch operator-() const {
+    SingleVariableBatch result{};
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      for (std::size_t l = 0; l < Width; ++l) {
+        result.values[i][l] = -this->values[i][l];
+      }
+    }
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator-(const SingleVariableBatch &rhs) const {
+    SingleVariableBatch result{};
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      for (std::size_t l = 0; l < Width; ++l) {
+        result.values[i][l] = this->values[i][l] - rhs.values[i][l];
+      }
+    }
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator-(const ValType &rhs) const {
+    return *this + (-rhs);
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  operator-(const ValType &lhs, const SingleVariableBatch &rhs) {
+    return -rhs + lhs;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator*(const SingleVariableBatch &rhs) const {
+    SingleVariableBatch result{};
+    detail::series_mul(this->values, rhs.values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator*(const ValType &rhs) const {
+    SingleVariableBatch result{};
+    for (std::size_t i = 0; i < Order + 1; ++i) {
+      for (std::size_t l = 0; l < Width; ++l) {
+        result.values[i][l] = this->values[i][l] * rhs;
+      }
+    }
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  operator*(const ValType &lhs, const SingleVariableBatch &rhs) {
+    return rhs * lhs;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch inv() const {
+    return ValType{1} / *this;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator/(const SingleVariableBatch &rhs) const {
+    SingleVariableBatch result{};
+    detail::series_div(this->values, rhs.values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch
+  operator/(const ValType &rhs) const {
+    return *this * (1 / rhs);
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  operator/(const ValType &lhs, const SingleVariableBatch &rhs) {
+    SingleVariableBatch result{};
+    result.values[0] =
+        map(rhs.values[0], [lhs](ValType v) { return lhs * (1 / v); });
+    detail::series_reciprocal(rhs.values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch pow(const ValType &rhs) const {
+    SingleVariableBatch result{};
+    result.values[0] =
+        map(this->values[0], [&](ValType v) { return std::pow(v, rhs); });
+    detail::series_pow(this->values, rhs, result.values);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  pow(const SingleVariableBatch &self, const ValType &rhs) {
+    return self.pow(rhs);
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch sqrt() const {
+    return this->pow(1. / 2);
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  sqrt(const SingleVariableBatch &self) {
+    return self.sqrt();
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch cbrt() const {
+    return this->pow(1. / 3);
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  cbrt(const SingleVariableBatch &self) {
+    return self.cbrt();
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch exp() const {
+    SingleVariableBatch result{};
+    result.values[0] =
+        map(this->values[0], [](ValType v) { return std::exp(v); });
+    detail::series_exp(this->values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  exp(const SingleVariableBatch &self) {
+    return self.exp();
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch log() const {
+    SingleVariableBatch result{};
+    result.values[0] =
+        map(this->values[0], [](ValType v) { return std::log(v); });
+    detail::series_log(this->values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  log(const SingleVariableBatch &self) {
+    return self.log();
+  }
+
+  // sin と cos を同時に求める (SingleVariable::sincos と同じ漸化式)
+  [[nodiscard]] constexpr std::pair<SingleVariableBatch, SingleVariableBatch>
+  sincos() const {
+    SingleVariableBatch s{};
+    SingleVariableBatch c{};
+    s.values[0] = map(this->values[0], [](ValType v) { return std::sin(v); });
+    c.values[0] = map(this->values[0], [](ValType v) { return std::cos(v); });
+    detail::series_sincos(this->values, s.values, c.values);
+    return {s, c};
+  }
+
+  [[nodiscard]] friend constexpr std::pair<SingleVariableBatch,
+                                           SingleVariableBatch>
+  sincos(const SingleVariableBatch &self) {
+    return self.sincos();
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch sin() const {
+    return this->sincos().first;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  sin(const SingleVariableBatch &self) {
+    return self.sin();
+  }
+
+  [[nodiscard]] constexpr SingleVariableBatch cos() const {
+    return this->sincos().second;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  cos(const SingleVariableBatch &self) {
+    return self.cos();
+  }
+
+  // SingleVariable::tan と同じ 1 + tan^2 を使う漸化式
+  [[nodiscard]] constexpr SingleVariableBatch tan() const {
+    SingleVariableBatch result{};
+    result.values[0] =
+        map(this->values[0], [](ValType v) { return std::tan(v); });
+    detail::series_tan(this->values, result.values);
+    return result;
+  }
+
+  [[nodiscard]] friend constexpr SingleVariableBatch
+  tan(const SingleVariableBatch &self) {
+    return self.tan();
+  }
+
+  [[nodiscard]] constexpr ValType derivative(std::size_t order,
+                                             std::size_t lane) const {
+    return this->values.at(order).at(lane) * factorial(order);
+  }
+
+private:
+  [[nodiscard]] static constexpr ValType factorial(std::size_t n) {
+    ValType ret = 1;
+    for (std::size_t i = 2; i <= n; i++) {
+      ret *= static_cast<ValType>(i);
+    }
+    return ret;
+  }
+};
+
+} // namespace Autodiff
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "multi_index.hpp"
+#include "single_variable.hpp"
+#include "variable.hpp"
+
+namespace Autodiff {
+
+/*!
+ * 0 でない微分係数だけを持つ Variable
+ *
+ * 係数は (多重添字, 値) の組を Variable と同じ詰めた位置の順に並べた
+ * 配列で持つ。入力が多くても各中間値が少数の入力にしか依存しないとき、
+ * メモリと手間は Deps や Order ではなく実際の非零要素の数で決まる。
+ * 一変数関数は u0 = u[0], δ = u - u0 として f(u) = Σ f^(k)(u0) / k! δ^k
+ * を SingleVariable のテイラー係数からホーナー法で計算するので、積と同じく
+ * 非零要素だけをたどる。
+ **/
+template <size_t Deps = 2, size_t Order = 2> class SparseVariable {
+public:
+  using Index = typename MultiIndex<Deps, Order>::Index;
+
+  struct Entry {
+    size_t key; // 詰めた位置
+    Index index;
+    double value;
+  };
+
+private:
+  std::vector<Entry> entries;
+
+  // 詰めた位置で並んだ配列の、同じ位置の値をまとめて 0 を取り除く
+  void normalize() {
+    size_t n = 0;
+    for (size_t i = 0; i < entries.size();) {
+      auto entry = entries[i++];
+      while (i < entries.size() && entries[i].key == entry.key) {
+        entry.value += entries[i++].value;
+      }
+      if (entry.value != 0.) {
+        entries[n++] = entry;
+      }
+    }
+    entries.resize(n);
+  }
+
+  // 多重添字を降順に並べる (0 は「微分しない」で、Deps を超える添字は不正)
+  template <class It>
+  [[nodiscard]] static Index sorted_index(It first, It last) {
+    Index idx{};
+    for (size_t i = 0; first != last; ++first, i++) {
+      if (*first > Deps) [[unlikely]] {
+        throw std::runtime_error("SparseVariable: index must be <= Deps");
+      }
+      idx[i] = *first;
+    }
+    std::sort(idx.begin(), idx.end(), std::greater<>());
+    return idx;
+  }
+
+  [[nodiscard]] const Entry *find(size_t key) const {
+    auto it = std::lower_bound(
+        entries.begin(), entries.end(), key,
+        [](const Entry &a, size_t k) { return a.key < k; });
+    return it != entries.end() && it->key == key ? &*it : nullptr;
+  }
+
+  // 一変数関数の u0 まわりの展開 f を合成する
+  [[nodiscard]] SparseVariable
+  compose(const SingleVariable<Order, double> &f) const {
+    SparseVariable delta = *this;
+    if (!delta.entries.empty() && delta.entries.front().key == 0) {
+      delta.entries.erase(delta.entries.begin());
+    }
+    auto ret = SparseVariable(f.coefficient(Order));
+    for (size_t k = Order; k-- > 0;) {
+      ret = ret * delta + f.coefficient(k);
+    }
+    return ret;
+  }
+
+public:
+  SparseVariable() = default;
+
+  // 定数
+  explicit SparseVariable(double value) {
+    if (value != 0.) {
+      entries.push_back({0, Index{}, value});
+    }
+  }
+
+  // index 番目 (1 始まり) の独立変数
+  SparseVariable(double value, size_t index) : SparseVariable(value) {
+    if (index == 0 || index > Deps) [[unlikely]] {
+      throw std::runtime_error("SparseVariable: index must be in [1, Deps]");
+    }
+    Index idx{};
+    idx[0] = index;
+    entries.push_back({MultiIndex<Deps, Order>::rank(idx), idx, 1.0});
+  }
+
+  [[nodiscard]] std::span<const Entry> nonzeros() const { return entries; }
+
+  [[nodiscard]] size_t size() const { return entries.size(); }
+
+  [[nodiscard]] SparseVariable operator+(const SparseVariable &rhs) const {
+    SparseVariable ret;
+    ret.entries.reserve(entries.size() + rhs.entries.size());
+    std::merge(entries.begin(), entries.end(), rhs.entries.begin(),
+               rhs.entries.end(), std::back_inserter(ret.entries),
+               [](const Entry &a, const Entry &b) { return a.key < b.key; });
+    ret.normalize();
+    return ret;
+  }
+
+  [[nodiscard]] SparseVariable operator+(double rhs) const {
+    return *this + SparseVariable(rhs);
+  }
+
+  [[nodiscard]] friend SparseVariable operator+(double lhs,
+                                                const SparseVariable &rhs) {
+    return rhs + lhs;
+  }
+
+  [[nodiscard]] SparseVariable operator-() const { return *this * -1.; }
+
+  [[nodiscard]] SparseVariable operator-(const SparseVariable &rhs) const {
+    return *this + -rhs;
+  }
+
+  [[nodiscard]] SparseVariable operator*(double rhs) const {
+    if (rhs == 0.) {
+      return {};
+    }
+    SparseVariable ret(*this);
+    for (auto &entry : ret.entries) {
+      entry.value *= rhs;
+    }
+    return ret;
+  }
+
+  [[nodiscard]] friend SparseVariable operator*(double lhs,
+                                                const SparseVariable &rhs) {
+    return rhs * lhs;
+  }
+
+  /*!
+   * 非零要素の組 (I, a), (J, b) ごとに S = I + J (多重集合の和) へ
+   * Π_v C(S_v, I_v) a b を足す (S_v は S に含まれる v の数)
+   **/
+  [[nodiscard]] SparseVariable operator*(const SparseVariable &rhs) const {
+    using MI = MultiIndex<Deps, Order>;
+    SparseVariable ret;
+    for (const auto &a : entries) {
+      const auto da = MI::degree(a.index);
+      for (const auto &b : rhs.entries) {
+        const auto db = MI::degree(b.index);
+        if (da + db > Order) {
+          continue;
+        }
+        Index idx{};
+        std::merge(a.index.begin(), a.index.begin() + da, b.index.begin(),
+                   b.index.begin() + db, idx.begin(), std::greater<>());
+        double coeff = 1.;
+        for (size_t i = 0; i < da;) {
+          size_t na = 0;
+          size_t ns = 0;
+          const auto v = a.index[i];
+          while (i < da && a.index[i] == v) {
+            i++, na++;
+          }
+          for (size_t j = 0; j < da + db; j++) {
+            ns += idx[j] == v ? 1 : 0;
+          }
+          coeff *= static_cast<double>(binomial(ns, na));
+        }
+        ret.entries.push_back(
+            {MI::rank(idx), idx, coeff * a.value * b.value});
+      }
+    }
+    std::sort(ret.entries.begin(), ret.entries.end(),
+              [](const Entry &a, const Entry &b) { return a.key < b.key; });
+    ret.normalize();
+    return ret;
+  }
+
+  [[nodiscard]] SparseVariable inv() const {
+    return compose(single().inv());
+  }
+
+  friend SparseVariable inv(const SparseVariable &other) {
+    return other.inv();
+  }
+
+  [[nodiscard]] SparseVariable sin() const {
+    return compose(single().sin());
+  }
+
+  friend SparseVariable sin(const SparseVariable &other) {
+    return other.sin();
+  }
+
+  [[nodiscard]] SparseVariable cos() const {
+    return compose(single().cos());
+  }
+
+  friend SparseVariable cos(const SparseVariable &other) {
+    return other.cos();
+  }
+
+  [[nodiscard]] SparseVariable tan() const {
+    return compose(single().tan());
+  }
+
+  friend SparseVariable tan(const SparseVariable &other) {
+    return other.tan();
+  }
+
+  [[nodiscard]] SparseVariable exp() const {
+    return compose(single().exp());
+  }
+
+  friend SparseVariable exp(const SparseVariable &other) {
+    return other.exp();
+  }
+
+  [[nodiscard]] SparseVariable log() const {
+    return compose(single().log());
+  }
+
+  friend SparseVariable log(const SparseVariable &other) {
+    return other.log();
+  }
+
+  [[nodiscard]] SparseVariable pow(double p) const {
+    return compose(single().pow(p));
+  }
+
+  friend SparseVariable pow(const SparseVariable &other, double val) {
+    return other.pow(val);
+  }
+
+  [[nodiscard]] SparseVariable sqrt() const { return this->pow(1. / 2.); }
+
+  friend SparseVariable sqrt(const SparseVariable &other) {
+    return other.sqrt();
+  }
+
+  [[nodiscard]] SparseVariable cbrt() const { return this->pow(1. / 3.); }
+
+  friend SparseVariable cbrt(const SparseVariable &other) {
+    return other.cbrt();
+  }
+
+  void set(std::vector<size_t> vec, double val) {
+    if (vec.size() > Order) {
+      throw std::runtime_error("set: vec.size() > Order");
+    }
+    const auto idx = sorted_index(vec.begin(), vec.end());
+    const auto key = MultiIndex<Deps, Order>::rank(idx);
+    auto it = std::lower_bound(
+        entries.begin(), entries.end(), key,
+        [](const Entry &a, size_t k) { return a.key < k; });
+    if (it != entries.end() && it->key == key) {
+      if (val == 0.) {
+        entries.erase(it);
+      } else {
+        it->value = val;
+      }
+    } else if (val != 0.) {
+      entries.insert(it, {key, idx, val});
+    }
+  }
+
+  template <std::integral... Args> double derivative(Args... args) const {
+    static_assert(sizeof...(Args) <= Order);
+    const std::array<size_t, sizeof...(Args)> vec{static_cast<size_t>(args)...};
+    const auto idx = sorted_index(vec.begin(), vec.end());
+    const auto *entry = find(MultiIndex<Deps, Order>::rank(idx));
+    return entry != nullptr ? entry->value : 0.;
+  }
+
+  // 同じ係数を持つ Variable に変換する
+  [[nodiscard]] Variable<Deps, Order> dense() const {
+    Variable<Deps, Order> ret;
+    for (const auto &entry : entries) {
+      ret.repr[entry.key] = entry.value;
+    }
+    return ret;
+  }
+
+private:
+  [[nodiscard]] SingleVariable<Order, double> single() const {
+    const auto *value = find(0);
+    return SingleVariable<Order, double>(value != nullptr ? value->value : 0.);
+  }
+};
+
+} // namespace Autodiff
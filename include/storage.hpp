@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Autodiff {
+
+/*!
+ * 係数がこのバイト数を超える Variable は、既定で係数をスタックに置かず
+ * PooledStorage に置く
+ **/
+inline constexpr std::size_t VariableInlineBytes = 4096;
+
+// PooledStorage のバッファの境界 (キャッシュラインの大きさ)
+inline constexpr std::size_t StorageAlignment = 64;
+
+namespace detail {
+
+/*!
+ * Bytes バイトのバッファをスレッドごとの空きリストで使い回す
+ *
+ * 空いたバッファの先頭に次の空きバッファへのポインタを書いて単方向リストにする。
+ * 別のスレッドで確保したバッファを返してもよく、そのスレッドのリストに入る。
+ * リストに残ったバッファはスレッドの終了時に解放する。メインスレッドでは
+ * thread_local が静的な変数より先に破棄されるので、その後の確保と解放は
+ * リストを通さずに直接行う。
+ **/
+template <std::size_t Bytes> class BufferPool {
+  static_assert(Bytes % StorageAlignment == 0);
+
+  struct Node {
+    Node *next;
+  };
+
+  struct FreeList {
+    Node *head = nullptr;
+
+    FreeList() { state() = State::Alive; }
+    FreeList(const FreeList &) = delete;
+    FreeList &operator=(const FreeList &) = delete;
+
+    ~FreeList() {
+      state() = State::Destroyed;
+      while (head != nullptr) {
+        auto *next = head->next;
+        ::operator delete(head, std::align_val_t{StorageAlignment});
+        head = next;
+      }
+    }
+  };
+
+  enum class State { Unused, Alive, Destroyed };
+
+  // このスレッドの FreeList の状態 (自明なデストラクタなので FreeList より長生きする)
+  static State &state() {
+    thread_local State value = State::Unused;
+    return value;
+  }
+
+  static FreeList &free_list() {
+    thread_local FreeList list;
+    return list;
+  }
+
+public:
+  [[nodiscard]] static void *acquire() {
+    if (state() == State::Destroyed) [[unlikely]] {
+      return ::operator new(Bytes, std::align_val_t{StorageAlignment});
+    }
+    auto &list = free_list();
+    if (list.head != nullptr) {
+      auto *node = list.head;
+      list.head = node->next;
+      return node;
+    }
+    return ::operator new(Bytes, std::align_val_t{StorageAlignment});
+  }
+
+  static void release(void *buffer) {
+    if (state() == State::Destroyed) [[unlikely]] {
+      ::operator delete(buffer, std::align_val_t{StorageAlignment});
+      return;
+    }
+    auto &list = free_list();
+    list.head = ::new (buffer) Node{list.head};
+  }
+};
+
+} // namespace detail
+
+/*!
+ * N 個の T をキャッシュライン境界に揃えたヒープのバッファに置く
+ *
+ * std::array と同じように使えるが、ムーブはポインタの付け替えだけで済む。
+ * バッファは同じ大きさごとにスレッドローカルの空きリストで使い回すので、
+ * 一時オブジェクトを作り直してもほとんど確保は起きない。
+ * ムーブ元は空きリストから新しい (値が 0 の) バッファを受け取るので、
+ * ムーブ後もそのまま使える。定数式の中では std::allocator で確保する。
+ **/
+template <class T, std::size_t N> class PooledStorage {
+  static constexpr std::size_t BYTES =
+      (sizeof(T) * N + StorageAlignment - 1) / StorageAlignment *
+      StorageAlignment;
+
+  using Pool = detail::BufferPool<BYTES>;
+
+  T *buffer = nullptr;
+
+  [[nodiscard]] static constexpr T *allocate() {
+    if consteval {
+      auto *ret = std::allocator<T>{}.allocate(N);
+      for (std::size_t i = 0; i < N; i++) {
+        std::construct_at(ret + i);
+      }
+      return ret;
+    } else {
+      auto *ret = static_cast<T *>(Pool::acquire());
+      std::uninitialized_value_construct_n(ret, N);
+      return ret;
+    }
+  }
+
+  constexpr void release() {
+    std::destroy_n(buffer, N);
+    if consteval {
+      std::allocator<T>{}.deallocate(buffer, N);
+    } else {
+      Pool::release(buffer);
+    }
+  }
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  constexpr PooledStorage() : buffer(allocate()) {}
+
+  constexpr PooledStorage(const PooledStorage &other) : buffer(allocate()) {
+    std::copy(other.begin(), other.end(), buffer);
+  }
+
+  // バッファを付け替え、ムーブ元には新しいバッファを渡す
+  constexpr PooledStorage(PooledStorage &&other)
+      : buffer(std::exchange(other.buffer, allocate())) {}
+
+  constexpr PooledStorage &operator=(const PooledStorage &other) {
+    if (this != &other) {
+      std::copy(other.begin(), other.end(), buffer);
+    }
+    return *this;
+  }
+
+  constexpr PooledStorage &operator=(PooledStorage &&other) noexcept {
+    std::swap(buffer, other.buffer);
+    return *this;
+  }
+
+  constexpr ~PooledStorage() { release(); }
+
+  [[nodiscard]] static constexpr std::size_t size() { return N; }
+
+  [[nodiscard]] constexpr T *data() { return buffer; }
+  [[nodiscard]] constexpr const T *data() const { return buffer; }
+
+  [[nodiscard]] constexpr T &operator[](std::size_t i) { return buffer[i]; }
+  [[nodiscard]] constexpr const T &operator[](std::size_t i) const {
+    return buffer[i];
+  }
+
+  [[nodiscard]] constexpr T *begin() { return buffer; }
+  [[nodiscard]] constexpr const T *begin() const { return buffer; }
+  [[nodiscard]] constexpr T *end() { return buffer + N; }
+  [[nodiscard]] constexpr const T *end() const { return buffer + N; }
+
+  friend constexpr void swap(PooledStorage &lhs, PooledStorage &rhs) noexcept {
+    std::swap(lhs.buffer, rhs.buffer);
+  }
+};
+
+// 係数をそのままオブジェクトの中に置く
+template <class T, std::size_t N> using InlineStorage = std::array<T, N>;
+
+// VariableInlineBytes までは InlineStorage、それより大きければ PooledStorage
+template <class T, std::size_t N>
+using AutoStorage = std::conditional_t<sizeof(T) * N <= VariableInlineBytes,
+                                       InlineStorage<T, N>,
+                                       PooledStorage<T, N>>;
+
+} // namespace Autodiff
@@ -1,72 +1,59 @@
+#pragma once
+
 #include <algorithm>
 #include <array>
-#include <bitset>
+#include <cmath>
+#include <concepts>
 #include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 #include "constant.hpp"
-#include "generator.hpp"
+#include "multi_index.hpp"
+#include "numeric.hpp"
+#include "schedule.hpp"
 #include "single_variable.hpp"
+#include "storage.hpp"
 
 namespace Autodiff {
 
-template <size_t I, size_t N> struct Pow {
-  static constexpr size_t value = I * Pow<I, N - 1>::value;
-};
-
-template <size_t I> struct Pow<I, 0> {
-  static constexpr size_t value = 1;
-};
-
 template <size_t Order, size_t N> struct InternalNum {
-  InternalNum() = default;
-  InternalNum(InternalNum &&) noexcept = default;
-  InternalNum &operator=(const InternalNum &) = default;
-  InternalNum &operator=(InternalNum &&) noexcept = default;
+  constexpr InternalNum() = default;
+  constexpr InternalNum(InternalNum &&) noexcept = default;
+  constexpr InternalNum &operator=(const InternalNum &) = default;
+  constexpr InternalNum &operator=(InternalNum &&) noexcept = default;
 
-  InternalNum(const InternalNum &other)
+  constexpr InternalNum(const InternalNum &other)
       : repr(other.repr), counter(other.counter) {}
 
-  explicit InternalNum(size_t repr) {
-    for (size_t i = 0; i < Order; i++) {
-      this->repr[i] = repr % (N + 1);
-      repr /= (N + 1);
-    }
-  }
-
-  bool valid() {
-    auto prev = Order;
-    for (size_t i = 0; i < Order; i++) {
-      if (prev < repr[i]) {
-        return false;
-      }
-      prev = repr[i];
+  // 詰めた位置から多重添字を復元する
+  explicit constexpr InternalNum(size_t repr) {
+    if (repr >= MultiIndex<N, Order>::SIZE) [[unlikely]] {
+      throw std::runtime_error("InternalNum: repr >= SIZE");
     }
-    return true;
+    this->repr = MultiIndex<N, Order>::TABLE[repr];
   }
 
-  ~InternalNum() = default;
+  constexpr ~InternalNum() = default;
 
   std::array<size_t, Order> repr{};
   size_t counter = 0;
 
-  static constexpr size_t MAX_NUM = std::pow(N, Order);
-
-  [[nodiscard]] std::array<size_t, Order> get_repr_arr() const { return repr; }
+  [[nodiscard]] constexpr std::array<size_t, Order> get_repr_arr() const {
+    return repr;
+  }
 
-  [[nodiscard]] const std::array<size_t, Order> *get_repr_arr_ptr() const {
+  [[nodiscard]] constexpr const std::array<size_t, Order> *
+  get_repr_arr_ptr() const {
     return &repr;
   }
 
-  [[nodiscard]] size_t get_repr() const {
-    size_t ret = 0;
-    for (size_t i = 0; i < Order; i++) {
-      ret += repr[i] * std::pow(N + 1, i);
-    }
-    return ret;
+  [[nodiscard]] constexpr size_t get_repr() const {
+    return MultiIndex<N, Order>::rank(repr);
   }
 
-  void set(size_t num) {
+  constexpr void set(size_t num) {
     if (counter >= Order) [[unlikely]] {
       throw std::runtime_error("BaseN::set: counter >= Order");
     }
@@ -77,7 +64,7 @@ template <size_t Order, size_t N> struct InternalNum {
     counter++;
   }
 
-  [[nodiscard]] size_t at(size_t i) const {
+  [[nodiscard]] constexpr size_t at(size_t i) const {
     if (i >= N + 1) [[unlikely]] {
       throw std::runtime_error("BaseN::set: num >= N");
     }
@@ -91,350 +78,476 @@ template <size_t Order, size_t N> struct InternalNum {
     return os;
   }
 
-  void normalize() { std::sort(repr.begin(), repr.end(), std::greater<>()); }
+  constexpr void normalize() {
+    std::sort(repr.begin(), repr.end(), std::greater<>());
+  }
 };
 
-template <size_t Deps = 2, size_t Order = 2> class Variable {
+/*!
+ * Deps 変数の Order 階までの自動微分
+ * 係数は ValType で持つ。ValType は Numeric なら何でもよく、SingleVariable
+ * を入れ子にすると入力とは別の方向の微分を係数ごとに持てる。
+ * 係数の置き場所は Storage で選ぶ (既定では大きいときだけヒープに置く)
+ **/
+template <size_t Deps = 2, size_t Order = 2, Numeric ValType = double,
+          template <class, size_t> class Storage = AutoStorage>
+class Variable : public RealScalarOps<Variable<Deps, Order, ValType, Storage>,
+                                      ValType> {
+  friend RealScalarOps<Variable, ValType>;
+
 public:
-  using VecB = std::vector<InternalNum<Order, Deps>>;
+  using Real = RealOf<ValType>;
+  using Mask = DepMask<Deps>;
 
-  std::array<double, Pow<Deps + 1, Order>::value> repr{};
+  Storage<ValType, MultiIndex<Deps, Order>::SIZE> repr{};
 
-  [[nodiscard]] constexpr Variable
-  operator+([[maybe_unused]] const Variable &rhs) const {
-    Variable ret(rhs);
-    for (size_t i = 0; i < rhs.repr.size(); i++) {
-      ret.repr[i] += this->repr[i];
-    }
-    return ret;
-  }
+  Variable() = default;
 
-  [[nodiscard]] friend constexpr Variable
-  operator+([[maybe_unused]] double lhs, [[maybe_unused]] const Variable &rhs) {
-    Variable ret(rhs);
-    ret.repr[0] += lhs;
-    return ret;
+  // 定数 (後から repr に微分係数を書いてもよいように全入力に依存するとみなす)
+  explicit constexpr Variable(ValType value) { this->repr[0] = value; }
+
+  /*!
+   * index 番目 (1 始まり) の独立変数
+   * 依存先は自分だけなので、他の入力での微分は repr に直接書かず set で書く
+   **/
+  constexpr Variable(ValType value, size_t index) : inputs() {
+    if (index == 0 || index > Deps) [[unlikely]] {
+      throw std::runtime_error("Variable: index must be in [1, Deps]");
+    }
+    this->repr[0] = value;
+    this->inputs.set(index);
+    this->repr[MultiIndex<Deps, Order>::offset(1) + index - 1] =
+        NumericTraits<ValType>::constant(1);
   }
 
-  [[nodiscard]] Variable operator*([[maybe_unused]] const Variable &rhs) {
-    Variable ret;
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+  constexpr Variable &operator+=(const Variable &rhs) {
+    const bool dense = rhs.inputs.all();
+    for (size_t i = 0; i < repr.size(); i++) {
+      if (!dense && structural_zero(i, rhs.inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      auto ar = std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (size_t j = 0, arr_len = ar.size(),
-                  coeff_size = MULT_COEFF.at(arr_len).size();
-           j < coeff_size; ++j) {
-        auto idx1 = InternalNum<Order, Deps>(0);
-        auto idx2 = InternalNum<Order, Deps>(0);
-        for (size_t k = 0; k < arr_len; ++k) {
-          auto k1 = MULT_COEFF.at(arr_len).at(j).at(k);
-          auto k2 = MULT_COEFF.at(arr_len).at(coeff_size - j - 1).at(k);
-          if (k1 != 0u) {
-            idx1.set(ar[k1 - 1]);
-          }
-          if (k2 != 0u) {
-            idx2.set(ar[k2 - 1]);
-          }
-        }
-        idx1.normalize();
-        idx2.normalize();
-        ret.repr[i.get_repr()] +=
-            this->repr[idx1.get_repr()] * rhs.repr[idx2.get_repr()];
-      }
+      this->repr[i] += rhs.repr[i];
     }
-    return ret;
+    this->inputs |= rhs.inputs;
+    return *this;
   }
 
-  [[nodiscard]] friend constexpr Variable operator*(double lhs,
-                                                    const Variable &rhs) {
-    Variable ret(rhs);
-    for (auto &&i : ret.repr) {
-      i *= lhs;
-    }
-    return ret;
+  constexpr Variable &operator+=(ValType rhs) {
+    this->repr[0] += rhs;
+    return *this;
   }
 
-  [[nodiscard]] Variable inv() const {
-    Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.inv();
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+  constexpr Variable &operator-=(const Variable &rhs) {
+    const bool dense = rhs.inputs.all();
+    for (size_t i = 0; i < repr.size(); i++) {
+      if (!dense && structural_zero(i, rhs.inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
-        }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
-      }
-    Escape:
-      void();
+      this->repr[i] -= rhs.repr[i];
     }
-    return ret;
+    this->inputs |= rhs.inputs;
+    return *this;
   }
 
-  friend constexpr Variable inv(const Variable &other) { return other.inv(); }
+  constexpr Variable &operator-=(ValType rhs) {
+    this->repr[0] -= rhs;
+    return *this;
+  }
 
-  [[nodiscard]] Variable sin() const {
-    Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.sin();
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+  /*!
+   * 詰めた位置 n の項は n 以下の位置の係数しか使わないので、
+   * 後ろから計算すれば作業領域なしで上書きできる (rhs が自分自身でもよい)。
+   * どちらも依存しない入力を含む位置は 0 のままなので飛ばす
+   **/
+  constexpr Variable &operator*=(const Variable &rhs) {
+    const auto &schedule = MultSchedule<Deps, Order>::table();
+    this->inputs |= rhs.inputs;
+    const bool dense = this->inputs.all();
+    for (size_t n = repr.size(); n-- > 0;) {
+      if (!dense && structural_zero(n, this->inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
-        }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
+      ValType acc{};
+      for (auto t = schedule.start[n]; t < schedule.start[n + 1]; t++) {
+        acc += this->repr[schedule.lhs[t]] * rhs.repr[schedule.rhs[t]];
       }
-    Escape:
-      void();
+      this->repr[n] = acc;
     }
-    return ret;
+    return *this;
   }
 
-  friend constexpr Variable sin(const Variable &other) { return other.sin(); }
+  constexpr Variable &operator*=(ValType rhs) {
+    for (auto &&i : this->repr) {
+      i *= rhs;
+    }
+    return *this;
+  }
 
-  [[nodiscard]] Variable cos() const {
-    Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.cos();
+  constexpr Variable &operator/=(ValType rhs) { return *this *= Real{1} / rhs; }
+
+  /*!
+   * this = q * rhs を q について前から解く。各位置の最後の項が q[n] * rhs[0]
+   * なので、それ以外の項を引いて rhs[0] で割る (SingleVariable と同じ漸化式)
+   **/
+  constexpr Variable &operator/=(const Variable &rhs) {
+    if (this == &rhs) {
+      return *this = bare_constant(NumericTraits<ValType>::constant(1));
+    }
+    const auto &schedule = MultSchedule<Deps, Order>::table();
+    const auto inv_value = Real{1} / rhs.repr[0];
+    this->inputs |= rhs.inputs;
+    const bool dense = this->inputs.all();
     for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+      if (!dense && structural_zero(n, this->inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
-        }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
+      ValType acc = this->repr[n];
+      for (auto t = schedule.start[n]; t + 1 < schedule.start[n + 1]; t++) {
+        acc -= this->repr[schedule.lhs[t]] * rhs.repr[schedule.rhs[t]];
       }
-    Escape:
-      void();
+      this->repr[n] = acc * inv_value;
     }
+    return *this;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator+(Variable lhs,
+                                                    const Variable &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator+(const Variable &lhs,
+                                                    Variable &&rhs) {
+    rhs += lhs;
+    return rhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator+(Variable lhs, ValType rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator+(ValType lhs, Variable rhs) {
+    rhs += lhs;
+    return rhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator-(Variable self) {
+    self *= Real{-1};
+    return self;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator-(Variable lhs,
+                                                    const Variable &rhs) {
+    lhs -= rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator-(const Variable &lhs,
+                                                    Variable &&rhs) {
+    rhs *= Real{-1};
+    rhs += lhs;
+    return rhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator-(Variable lhs, ValType rhs) {
+    lhs -= rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator-(ValType lhs, Variable rhs) {
+    rhs *= Real{-1};
+    rhs += lhs;
+    return rhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator*(Variable lhs,
+                                                    const Variable &rhs) {
+    lhs *= rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator*(const Variable &lhs,
+                                                    Variable &&rhs) {
+    rhs *= lhs;
+    return rhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator*(Variable lhs, ValType rhs) {
+    lhs *= rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator*(ValType lhs, Variable rhs) {
+    rhs *= lhs;
+    return rhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator/(Variable lhs,
+                                                    const Variable &rhs) {
+    lhs /= rhs;
+    return lhs;
+  }
+
+  [[nodiscard]] friend constexpr Variable operator/(ValType lhs,
+                                                    const Variable &rhs) {
+    auto ret = bare_constant(lhs);
+    ret /= rhs;
     return ret;
   }
 
-  friend constexpr Variable cos(const Variable &other) { return other.cos(); }
+  [[nodiscard]] friend constexpr Variable operator/(Variable lhs, ValType rhs) {
+    lhs /= rhs;
+    return lhs;
+  }
 
-  [[nodiscard]] Variable tan() const {
-    Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.tan();
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+  // 入れ子のときの Real との複合代入
+  using RealScalarOps<Variable, ValType>::operator+=;
+  using RealScalarOps<Variable, ValType>::operator-=;
+  using RealScalarOps<Variable, ValType>::operator*=;
+  using RealScalarOps<Variable, ValType>::operator/=;
+
+  /*!
+   * 一変数関数 f の repr[0] まわりのテイラー展開 f を合成する
+   * f.derivative(j) に f の j 階微分が入っている必要がある
+   **/
+  [[nodiscard]] constexpr Variable
+  compose(const SingleVariable<Order, ValType> &f) const {
+    const auto &schedule = CompositionSchedule<Deps, Order>::table();
+    std::array<ValType, Order + 1> coeff{};
+    for (size_t j = 0; j <= Order; j++) {
+      coeff[j] = f.derivative(j);
+    }
+    Variable ret(coeff[0]);
+    ret.inputs = this->inputs;
+    const bool dense = ret.inputs.all();
+    for (size_t n = 1; n < repr.size(); n++) {
+      if (!dense && structural_zero(n, ret.inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
+      ValType acc{};
+      for (auto t = schedule.start[n]; t < schedule.start[n + 1]; t++) {
+        const auto begin = schedule.factor_start[t];
+        const auto end = schedule.factor_start[t + 1];
+        auto tmp = coeff[end - begin];
+        for (auto i = begin; i < end; i++) {
+          tmp *= this->repr[schedule.factor[i]];
         }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
+        acc += tmp;
       }
-    Escape:
-      void();
+      ret.repr[n] = acc;
     }
     return ret;
   }
 
+  [[nodiscard]] constexpr Variable inv() const { return compose(single().inv()); }
+
+  friend constexpr Variable inv(const Variable &other) { return other.inv(); }
+
+  [[nodiscard]] constexpr Variable sin() const { return compose(single().sin()); }
+
+  friend constexpr Variable sin(const Variable &other) { return other.sin(); }
+
+  [[nodiscard]] constexpr Variable cos() const { return compose(single().cos()); }
+
+  friend constexpr Variable cos(const Variable &other) { return other.cos(); }
+
+  [[nodiscard]] constexpr Variable tan() const { return compose(single().tan()); }
+
   friend constexpr Variable tan(const Variable &other) { return other.tan(); }
 
-  [[nodiscard]] Variable exp() const {
+  [[nodiscard]] constexpr Variable exp() const { return compose(single().exp()); }
+
+  friend constexpr Variable exp(const Variable &other) { return other.exp(); }
+
+  [[nodiscard]] constexpr Variable log() const { return compose(single().log()); }
+
+  friend constexpr Variable log(const Variable &other) { return other.log(); }
+
+  [[nodiscard]] constexpr Variable asin() const {
+    return compose(single().asin());
+  }
+
+  friend constexpr Variable asin(const Variable &other) { return other.asin(); }
+
+  [[nodiscard]] constexpr Variable atan() const {
+    return compose(single().atan());
+  }
+
+  friend constexpr Variable atan(const Variable &other) { return other.atan(); }
+
+  [[nodiscard]] constexpr Variable sinh() const {
+    return compose(single().sinh());
+  }
+
+  friend constexpr Variable sinh(const Variable &other) { return other.sinh(); }
+
+  [[nodiscard]] constexpr Variable cosh() const {
+    return compose(single().cosh());
+  }
+
+  friend constexpr Variable cosh(const Variable &other) { return other.cosh(); }
+
+  [[nodiscard]] constexpr Variable tanh() const {
+    return compose(single().tanh());
+  }
+
+  friend constexpr Variable tanh(const Variable &other) { return other.tanh(); }
+
+  [[nodiscard]] constexpr Variable erf() const {
+    return compose(single().erf());
+  }
+
+  friend constexpr Variable erf(const Variable &other) { return other.erf(); }
+
+  [[nodiscard]] constexpr Variable expm1() const {
+    return compose(single().expm1());
+  }
+
+  friend constexpr Variable expm1(const Variable &other) {
+    return other.expm1();
+  }
+
+  [[nodiscard]] constexpr Variable log1p() const {
+    return compose(single().log1p());
+  }
+
+  friend constexpr Variable log1p(const Variable &other) {
+    return other.log1p();
+  }
+
+  [[nodiscard]] constexpr Variable pow(Real p) const {
+    return compose(single().pow(p));
+  }
+
+  friend constexpr Variable pow(const Variable &other, Real val) {
+    return other.pow(val);
+  }
+
+  /*!
+   * u^v を exp(v log u) として log u, v log u と同時に求める
+   *
+   * n の先頭の添字 p で微分した関係式 (u ∂_p l = ∂_p u, ∂_p r = r ∂_p w) に
+   * 残りの添字の微分をライプニッツ則で掛ける。p が rhs 側に入る項は
+   * 展開表のビットマスクが偶数の項なので、それだけをたどればよい。
+   **/
+  [[nodiscard]] constexpr Variable pow(const Variable &rhs) const {
+    const auto &schedule = MultSchedule<Deps, Order>::table();
+    Variable l;
+    Variable w;
     Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.exp();
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+    l.repr[0] = Math::log(this->repr[0]);
+    w.repr[0] = rhs.repr[0] * l.repr[0];
+    ret.repr[0] = Math::pow(this->repr[0], rhs.repr[0]);
+    const auto inv_value = Real{1} / this->repr[0];
+    ret.inputs = this->inputs | rhs.inputs;
+    const bool dense = ret.inputs.all();
+    for (size_t n = 1; n < repr.size(); n++) {
+      if (!dense && structural_zero(n, ret.inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
-        }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
+      const auto begin = schedule.start[n];
+      const auto end = schedule.start[n + 1];
+      ValType acc = this->repr[n];
+      for (auto t = begin + 2; t < end; t += 2) {
+        acc -= this->repr[schedule.lhs[t]] * l.repr[schedule.rhs[t]];
+      }
+      l.repr[n] = acc * inv_value;
+      acc = ValType{};
+      for (auto t = begin; t < end; t++) {
+        acc += rhs.repr[schedule.lhs[t]] * l.repr[schedule.rhs[t]];
       }
-    Escape:
-      void();
+      w.repr[n] = acc;
+      acc = ValType{};
+      for (auto t = begin; t < end; t += 2) {
+        acc += ret.repr[schedule.lhs[t]] * w.repr[schedule.rhs[t]];
+      }
+      ret.repr[n] = acc;
     }
     return ret;
   }
 
-  friend constexpr Variable exp(const Variable &other) { return other.exp(); }
+  friend constexpr Variable pow(const Variable &other, const Variable &val) {
+    return other.pow(val);
+  }
 
-  [[nodiscard]] Variable log() const {
+  /*!
+   * d = x^2 + y^2 として d ∂_p θ = x ∂_p y - y ∂_p x を pow と同じく
+   * ビットマスクが偶数の項で展開する (先頭の項が d[0] θ[n])
+   **/
+  friend constexpr Variable atan2(const Variable &y, const Variable &x) {
+    const auto &schedule = MultSchedule<Deps, Order>::table();
+    Variable d;
     Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.log();
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+    ret.repr[0] = Math::atan2(y.repr[0], x.repr[0]);
+    d.repr[0] = x.repr[0] * x.repr[0] + y.repr[0] * y.repr[0];
+    const auto inv_value = Real{1} / d.repr[0];
+    ret.inputs = y.inputs | x.inputs;
+    const bool dense = ret.inputs.all();
+    for (size_t n = 1; n < ret.repr.size(); n++) {
+      if (!dense && structural_zero(n, ret.inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
+      const auto begin = schedule.start[n];
+      const auto end = schedule.start[n + 1];
+      ValType acc{};
+      for (auto t = begin; t < end; t += 2) {
+        const auto l = schedule.lhs[t];
+        const auto r = schedule.rhs[t];
+        acc += x.repr[l] * y.repr[r] - y.repr[l] * x.repr[r];
+        if (t != begin) {
+          acc -= d.repr[l] * ret.repr[r];
         }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
       }
-    Escape:
-      void();
+      ret.repr[n] = acc * inv_value;
+      acc = ValType{};
+      for (auto t = begin; t < end; t++) {
+        const auto l = schedule.lhs[t];
+        const auto r = schedule.rhs[t];
+        acc += x.repr[l] * x.repr[r] + y.repr[l] * y.repr[r];
+      }
+      d.repr[n] = acc;
     }
     return ret;
   }
 
-  friend constexpr Variable log(const Variable &other) { return other.log(); }
-
-  [[nodiscard]] Variable pow(double p) const {
+  // h^2 = x^2 + y^2 の展開の最初と最後の項 h[0] h[n] 以外を引いて 2 h[0] で割る
+  friend constexpr Variable hypot(const Variable &x, const Variable &y) {
+    const auto &schedule = MultSchedule<Deps, Order>::table();
     Variable ret;
-    SingleVariable<Order, double> x;
-    x.set_value(this->repr[0], 0);
-    x.set_value(1.0, 1);
-    x = x.pow(p);
-    for (size_t n = 0; n < repr.size(); n++) {
-      auto i = InternalNum<Order, Deps>(n);
-      if (!i.valid()) {
+    ret.repr[0] = Math::hypot(x.repr[0], y.repr[0]);
+    const auto inv_value = Real{1} / (Real{2} * ret.repr[0]);
+    ret.inputs = x.inputs | y.inputs;
+    const bool dense = ret.inputs.all();
+    for (size_t n = 1; n < ret.repr.size(); n++) {
+      if (!dense && structural_zero(n, ret.inputs)) {
         continue;
       }
-      const auto *arr = i.get_repr_arr_ptr();
-      const auto ar =
-          std::span(arr->begin(), std::find(arr->begin(), arr->end(), 0));
-      for (const auto &j : SINGLE_COEFF.at(ar.size())) {
-        auto tmp = 1.0;
-        for (const auto &k : j) {
-          auto idx = InternalNum<Order, Deps>(0);
-          for (const auto &l : k) {
-            idx.set(ar[l - 1]);
-          }
-          idx.normalize();
-          auto idx_num = idx.get_repr();
-          if (this->repr[idx_num] == 0.) [[unlikely]] {
-            goto Escape;
-          }
-          tmp *= this->repr[idx_num];
+      const auto begin = schedule.start[n];
+      const auto end = schedule.start[n + 1];
+      ValType acc{};
+      for (auto t = begin; t < end; t++) {
+        const auto l = schedule.lhs[t];
+        const auto r = schedule.rhs[t];
+        acc += x.repr[l] * x.repr[r] + y.repr[l] * y.repr[r];
+        if (t != begin && t + 1 != end) {
+          acc -= ret.repr[l] * ret.repr[r];
         }
-        ret.repr[i.get_repr()] += tmp * x.derivative(j.size());
       }
-    Escape:
-      void();
+      ret.repr[n] = acc * inv_value;
     }
     return ret;
   }
 
-  friend constexpr Variable pow(const Variable &other, double val) {
-    return other.pow(val);
-  }
-
-  [[nodiscard]] constexpr Variable sqrt() const { return this->pow(1. / 2.); }
+  [[nodiscard]] constexpr Variable sqrt() const { return this->pow(Real{1} / 2); }
 
   friend constexpr Variable sqrt(const Variable &other) { return other.sqrt(); }
 
-  [[nodiscard]] constexpr Variable cbrt() const { return this->pow(1. / 3.); }
+  [[nodiscard]] constexpr Variable cbrt() const { return this->pow(Real{1} / 3); }
 
   friend constexpr Variable cbrt(const Variable &other) { return other.cbrt(); }
 
-  void set(std::vector<size_t> vec, double val) {
+  constexpr void set(std::vector<size_t> vec, ValType val) {
     auto num = InternalNum<Order, Deps>();
     if (vec.size() > Order) {
       throw std::runtime_error("set: vec.size() > Order");
@@ -443,27 +556,151 @@ public:
       num.set(i);
     }
     num.normalize();
+    for (auto &&i : vec) {
+      if (i != 0) {
+        inputs.set(i);
+      }
+    }
     repr[num.get_repr()] = val;
   }
 
-  template <std::integral... Args> double derivative(Args... args) {
+  // 構造的に 0 でない係数を持ちうる入力の集合
+  [[nodiscard]] constexpr const Mask &depends_on() const { return inputs; }
+
+  // 勾配 (∂/∂x_1, ..., ∂/∂x_Deps) を out に書き出す
+  constexpr void gradient(std::span<ValType> out) const { this->packed_tensor<1>(out); }
+
+  // 下三角を行優先で詰めたヘッセ行列 (Deps (Deps + 1) / 2 要素)
+  constexpr void packed_hessian(std::span<ValType> out) const {
+    this->packed_tensor<2>(out);
+  }
+
+  // 行優先のヘッセ行列 (Deps * Deps 要素)
+  constexpr void hessian(std::span<ValType> out) const {
+    this->tensor<2>(out);
+  }
+
+  /*!
+   * K 階微分の独立な成分を詰めた並びのまま書き出す
+   * 降順の多重添字 (i_1 >= ... >= i_K) を組み合わせ数系の順に並べたもので、
+   * K = 2 なら下三角の行優先になる
+   **/
+  template <size_t K>
+  constexpr void packed_tensor(std::span<ValType> out) const {
+    static_assert(1 <= K && K <= Order);
+    constexpr auto begin = MultiIndex<Deps, Order>::offset(K);
+    constexpr auto end = MultiIndex<Deps, Order>::offset(K + 1);
+    if (out.size() != end - begin) {
+      throw std::runtime_error("packed_tensor: out.size() mismatch");
+    }
+    std::copy(repr.begin() + begin, repr.begin() + end, out.begin());
+  }
+
+  // K 階微分を行優先の Deps^K 要素のテンソルとして書き出す
+  template <size_t K>
+  constexpr void tensor(std::span<ValType> out) const {
+    constexpr auto &map = TensorIndex<Deps, Order, K>::TABLE;
+    if (out.size() != map.size()) {
+      throw std::runtime_error("tensor: out.size() != Deps^K");
+    }
+    for (size_t i = 0; i < map.size(); i++) {
+      out[i] = repr[map[i]];
+    }
+  }
+
+  template <std::integral... Args>
+  [[nodiscard]] constexpr ValType derivative(Args... args) const {
     auto num = InternalNum<Order, Deps>();
     return derivative_impl(num, args...);
   }
 
   template <std::integral Head, std::integral... Tails>
-  double derivative_impl(InternalNum<Order, Deps> &num, Head head,
-                         Tails... tails) {
+  constexpr ValType derivative_impl(InternalNum<Order, Deps> &num, Head head,
+                                    Tails... tails) const {
     num.set(head);
     return derivative_impl(num, tails...);
   }
 
   template <std::integral Head>
-  double derivative_impl(InternalNum<Order, Deps> &num, Head head) {
+  constexpr ValType derivative_impl(InternalNum<Order, Deps> &num,
+                                    Head head) const {
     num.set(head);
     num.normalize();
     return repr[num.get_repr()];
   }
+
+private:
+  [[nodiscard]] constexpr auto &coeffs() { return repr; }
+
+  /*!
+   * どの入力に依存しうるか。含まれない入力での微分は構造的に 0 なので
+   * 各演算は該当する位置をまるごと飛ばす。独立変数は自分だけから始まり、
+   * 二項演算で和集合になる。repr は公開されていて直接書き換えられるので、
+   * 既定のコンストラクタと定数のコンストラクタでは全入力とする
+   **/
+  Mask inputs = Mask::full();
+
+  // 依存先が空の定数 (外に repr を書かれない演算の途中でだけ使う)
+  [[nodiscard]] static constexpr Variable bare_constant(ValType value) {
+    Variable ret(value);
+    ret.inputs = Mask();
+    return ret;
+  }
+
+  // 位置 n の係数が inputs に含まれない入力での微分か
+  [[nodiscard]] static constexpr bool structural_zero(size_t n,
+                                                      const Mask &inputs) {
+    for (const auto i : MultiIndex<Deps, Order>::TABLE[n]) {
+      if (i == 0) {
+        break;
+      }
+      if (!inputs.test(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // repr[0] を値とする一変数の自動微分
+  [[nodiscard]] constexpr SingleVariable<Order, ValType> single() const {
+    return SingleVariable<Order, ValType>(this->repr[0]);
+  }
 };
 
+template <size_t Deps, size_t Order, Numeric ValType,
+          template <class, size_t> class Storage>
+struct NumericTraits<Variable<Deps, Order, ValType, Storage>> {
+  using Real = RealOf<ValType>;
+
+  [[nodiscard]] static constexpr Variable<Deps, Order, ValType, Storage>
+  constant(Real value) {
+    return Variable<Deps, Order, ValType, Storage>(
+        NumericTraits<ValType>::constant(value));
+  }
+
+  [[nodiscard]] static constexpr bool
+  is_zero(const Variable<Deps, Order, ValType, Storage> &value) {
+    return std::ranges::all_of(value.repr, [](const ValType &v) {
+      return NumericTraits<ValType>::is_zero(v);
+    });
+  }
+};
+
+/*!
+ * 出力 ys の勾配を並べたヤコビ行列 (ys.size() 行 Deps 列、行優先) を書き出す
+ **/
+template <size_t Deps, size_t Order, Numeric ValType = double,
+          template <class, size_t> class Storage = AutoStorage>
+constexpr void jacobian(
+    std::type_identity_t<std::span<const Variable<Deps, Order, ValType, Storage>>>
+        ys,
+    std::type_identity_t<std::span<ValType>> out) {
+  if (out.size() != ys.size() * Deps) {
+    throw std::runtime_error("jacobian: out.size() != ys.size() * Deps");
+  }
+  for (size_t i = 0; i < ys.size(); i++) {
+    ys[i].gradient(out.subspan(i * Deps, Deps));
+  }
+}
+
 } // namespace Autodiff
@@ -0,0 +1,39 @@
+#include "expression.hpp"
+
+#include <gtest/gtest.h>
+
+using Autodiff::lazy;
+using Autodiff::SingleVariable;
+
+TEST(autodiff, ExpressionPolynomial) {
+  auto x = SingleVariable<5, double>(0.0);
+  SingleVariable<5, double> y = 2.0                           //
+                                + 3.0 * lazy(x)               //
+                                + 5.0 * x * x / 2.            //
+                                + 7.0 * x * x * x / 6.        //
+                                + 13.0 * x * x * x * x / 24.  //
+                                + 17.0 * x * x * x * x * x / 120.;
+
+  EXPECT_NEAR(y.derivative(0), 2., 1e-8);
+  EXPECT_NEAR(y.derivative(1), 3., 1e-8);
+  EXPECT_NEAR(y.derivative(2), 5., 1e-8);
+  EXPECT_NEAR(y.derivative(3), 7., 1e-8);
+  EXPECT_NEAR(y.derivative(4), 13., 1e-8);
+  EXPECT_NEAR(y.derivative(5), 17., 1e-8);
+}
+
+TEST(autodiff, ExpressionMixed) {
+  auto x = SingleVariable<3, double>(1.5);
+  auto expr = 1.0 - (lazy(x) - x.exp()) / 2.0 + -(x * lazy(x)) * 3.0;
+  SingleVariable<3, double> lazy_result = expr;
+  auto eager = 1.0 - (x - x.exp()) / 2.0 + -(x * x) * 3.0;
+  for (size_t i = 0; i <= 3; i++) {
+    EXPECT_NEAR(lazy_result.derivative(i), eager.derivative(i), 1e-12);
+  }
+
+  SingleVariable<3, double> quotient = (lazy(x) + 1.0) / (lazy(x) * x);
+  auto eager_quotient = (x + 1.0) / (x * x);
+  for (size_t i = 0; i <= 3; i++) {
+    EXPECT_NEAR(quotient.derivative(i), eager_quotient.derivative(i), 1e-12);
+  }
+}
@@ -0,0 +1,56 @@
+#include "parallel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using Autodiff::Variable;
+
+TEST(autodiff, ParallelEvaluate) {
+  std::vector<std::array<double, 2>> points(1000);
+  for (size_t p = 0; p < points.size(); p++) {
+    const auto t = static_cast<double>(p);
+    points[p] = {0.01 * t, 1.0 - 0.002 * t};
+  }
+  std::vector<Variable<2, 2>> out(points.size());
+  Autodiff::evaluate<2, 2>(
+      [](const auto &x) { return x[0] * x[1].sin() + x[0].exp(); }, points,
+      out, 4);
+
+  for (size_t p = 0; p < points.size(); p++) {
+    const auto [a, b] = points[p];
+    EXPECT_NEAR(out[p].derivative(0, 0), a * std::sin(b) + std::exp(a), 1e-8);
+    EXPECT_NEAR(out[p].derivative(1, 0), std::sin(b) + std::exp(a), 1e-8);
+    EXPECT_NEAR(out[p].derivative(2, 0), a * std::cos(b), 1e-8);
+    EXPECT_NEAR(out[p].derivative(1, 1), std::exp(a), 1e-8);
+    EXPECT_NEAR(out[p].derivative(1, 2), std::cos(b), 1e-8);
+    EXPECT_NEAR(out[p].derivative(2, 2), -a * std::sin(b), 1e-8);
+  }
+}
+
+TEST(autodiff, ParallelEvaluateException) {
+  std::vector<std::array<double, 1>> points(500);
+  std::vector<Variable<1, 1>> out(points.size());
+  auto fail = [](const auto &) -> Variable<1, 1> {
+    throw std::runtime_error("fail");
+  };
+  EXPECT_THROW((Autodiff::evaluate<1, 1>(fail, points, out, 4)),
+               std::runtime_error);
+}
+
+TEST(autodiff, ParallelEvaluateValType) {
+  std::vector<std::array<float, 1>> points(300);
+  for (size_t p = 0; p < points.size(); p++) {
+    points[p] = {0.01F * static_cast<float>(p)};
+  }
+  using Pooled = Variable<1, 2, float, Autodiff::PooledStorage>;
+  std::vector<Pooled> out(points.size());
+  Autodiff::evaluate<1, 2, float, Autodiff::PooledStorage>(
+      [](const auto &x) { return x[0] * x[0]; }, points, out, 2);
+  for (size_t p = 0; p < points.size(); p++) {
+    EXPECT_FLOAT_EQ(out[p].derivative(1), 2.F * points[p][0]);
+    EXPECT_EQ(out[p].derivative(1, 1), 2.F);
+  }
+}
@@ -0,0 +1,124 @@
+#include "reverse.hpp"
+#include "variable.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+using Autodiff::Tape;
+
+TEST(autodiff, ReverseGradient) {
+  Tape<> tape;
+  auto x = tape.variable(1.5);
+  auto y = tape.variable(0.5);
+  auto z = tape.variable(2.0);
+  auto f = x * y + z.sin() / x + y.exp() * z.log() - 3.0 * x.pow(1.4) +
+           1.0 / (y + z);
+  tape.backward(f);
+
+  const auto [a, b, c] = std::array{1.5, 0.5, 2.0};
+  EXPECT_NEAR(f.value(),
+              a * b + std::sin(c) / a + std::exp(b) * std::log(c) -
+                  3.0 * std::pow(a, 1.4) + 1.0 / (b + c),
+              1e-12);
+  EXPECT_NEAR(x.adjoint(),
+              b - std::sin(c) / (a * a) - 4.2 * std::pow(a, 0.4), 1e-12);
+  EXPECT_NEAR(y.adjoint(),
+              a + std::exp(b) * std::log(c) - 1.0 / ((b + c) * (b + c)),
+              1e-12);
+  EXPECT_NEAR(z.adjoint(),
+              std::cos(c) / a + std::exp(b) / c - 1.0 / ((b + c) * (b + c)),
+              1e-12);
+}
+
+TEST(autodiff, ReverseManyInputs) {
+  Tape<> tape;
+  std::vector<Autodiff::ReverseVariable<>> xs;
+  for (size_t i = 0; i < 200; i++) {
+    xs.push_back(tape.variable(0.01 * static_cast<double>(i + 1)));
+  }
+  auto f = xs[0] * xs[0];
+  for (size_t i = 1; i < xs.size(); i++) {
+    f = f + xs[i] * xs[i];
+  }
+  tape.backward(f);
+  for (const auto &x : xs) {
+    EXPECT_NEAR(x.adjoint(), 2.0 * x.value(), 1e-12);
+  }
+}
+
+TEST(autodiff, ReverseTapeReuse) {
+  Tape<> tape;
+  auto objective = [&](double a, double b) {
+    tape.clear();
+    auto x = tape.variable(a);
+    auto y = tape.variable(b);
+    auto f = (x * y).exp() + (x - y).sin();
+    tape.backward(f);
+    return std::array{x.adjoint(), y.adjoint()};
+  };
+
+  static_cast<void>(objective(0.1, 0.2));
+  const auto peak = tape.peak();
+  const auto capacity = tape.capacity();
+  EXPECT_EQ(peak, 7);
+  for (size_t i = 0; i < 100; i++) {
+    const auto a = 0.01 * static_cast<double>(i);
+    const auto grad = objective(a, 0.5);
+    EXPECT_NEAR(grad[0], 0.5 * std::exp(a * 0.5) + std::cos(a - 0.5), 1e-12);
+    EXPECT_NEAR(grad[1], a * std::exp(a * 0.5) - std::cos(a - 0.5), 1e-12);
+  }
+  EXPECT_EQ(tape.peak(), peak);
+  EXPECT_EQ(tape.capacity(), capacity);
+}
+
+TEST(autodiff, ReverseHessianVector) {
+  auto f = [](const auto &x) {
+    return x[0] * x[0] * x[1] + x[0].sin() * x[1].exp() + x[2].log() * x[0] +
+           (x[1] + x[2]).inv();
+  };
+  const std::array x{0.7, 0.3, 1.9};
+  const std::array v{1.0, -2.0, 0.5};
+  std::array<double, 3> gradient{};
+  std::array<double, 3> hv{};
+  Autodiff::hessian_vector<double>(f, x, v, gradient, hv);
+
+  // Variable<3, 2> で求めたヘッセ行列と比べる
+  std::array<Autodiff::Variable<3, 2>, 3> seeds;
+  for (size_t i = 0; i < 3; i++) {
+    seeds[i] = Autodiff::Variable<3, 2>(x[i], i + 1);
+  }
+  auto y = f(seeds);
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_NEAR(gradient[i], y.derivative(i + 1), 1e-12);
+    double expected = 0.;
+    for (size_t j = 0; j < 3; j++) {
+      expected += y.derivative(i + 1, j + 1) * v[j];
+    }
+    EXPECT_NEAR(hv[i], expected, 1e-12);
+  }
+}
+
+TEST(autodiff, ReverseHessianVectorTapeReuse) {
+  // 同じテープで呼び直すとノードも入力も領域を使い回す
+  auto f = [](const auto &x) { return x[0] * x[0] * x[1] + x[1].exp(); };
+  Tape<Autodiff::SingleVariable<1, double>> tape;
+  const std::array v{1.0, 0.0};
+  std::array<double, 2> gradient{};
+  std::array<double, 2> hv{};
+  Autodiff::hessian_vector<double>(tape, f, std::array{0.5, 0.25}, v,
+                                   gradient, hv);
+  const auto capacity = tape.capacity();
+  auto zero = [](size_t) { return Autodiff::SingleVariable<1, double>(); };
+  const auto *inputs = tape.variables(2, zero).data();
+  for (size_t i = 0; i < 10; i++) {
+    const auto a = 0.1 * static_cast<double>(i);
+    Autodiff::hessian_vector<double>(tape, f, std::array{a, 0.25}, v,
+                                     gradient, hv);
+    EXPECT_NEAR(gradient[0], 2. * a * 0.25, 1e-12);
+    EXPECT_NEAR(hv[0], 2. * 0.25, 1e-12);
+    EXPECT_NEAR(hv[1], 2. * a, 1e-12);
+  }
+  EXPECT_EQ(tape.capacity(), capacity);
+  EXPECT_EQ(tape.variables(2, zero).data(), inputs);
+}
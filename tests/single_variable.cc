@@ -4,6 +4,10 @@
 
 using Autodiff::SingleVariable;
 
+// 係数の大きさが揃った級数でだけカラツバ法とニュートン法を使う
+template <> inline constexpr bool Autodiff::SeriesKaratsuba<127> = true;
+template <> inline constexpr bool Autodiff::SeriesKaratsuba<1023> = true;
+
 static auto x = SingleVariable<5, double>(0.0);
 static auto y = 2.0                          //
                 + 3.0 * x                    //
@@ -115,3 +119,184 @@ TEST(autodiff, SingleVariableTan) {
   EXPECT_NEAR((y.tan()).derivative(4), -89615.364906299300, 1e-8);
   EXPECT_NEAR((y.tan()).derivative(5), 2737217.050492670000, 1e-8);
 }
+
+TEST(autodiff, SingleVariableSinCos) {
+  const auto [s, c] = y.sincos();
+  for (size_t i = 0; i <= 5; i++) {
+    EXPECT_NEAR(s.derivative(i), y.sin().derivative(i), 1e-8);
+    EXPECT_NEAR(c.derivative(i), y.cos().derivative(i), 1e-8);
+  }
+  EXPECT_NEAR(s.derivative(5), 1354.123949232650, 1e-8);
+  EXPECT_NEAR(c.derivative(5), 1024.401449683940, 1e-8);
+}
+
+TEST(autodiff, SingleVariableHighOrder) {
+  // exp の微分はすべて exp(x0)、1 / (1 - x) の n 階微分は n! / (1 - x0)^{n+1}
+  const auto t = SingleVariable<20, double>(0.5);
+  const auto e = t.exp();
+  const auto r = 1. / (1. - t);
+  double factorial = 1.;
+  for (size_t n = 0; n <= 20; n++) {
+    factorial *= n == 0 ? 1. : static_cast<double>(n);
+    EXPECT_NEAR(e.derivative(n) / std::exp(0.5), 1., 1e-12);
+    EXPECT_NEAR(e.coefficient(n) * factorial / std::exp(0.5), 1., 1e-12);
+    EXPECT_NEAR(r.derivative(n) / (factorial * std::pow(2., n + 1)), 1.,
+                1e-12);
+  }
+}
+
+TEST(autodiff, SingleVariableKaratsuba) {
+  // SeriesKaratsuba を有効にすると、長い積をカラツバ法で求める
+  constexpr size_t N = 127;
+  const auto t = SingleVariable<N, double>(0.);
+  const auto r = 1. / (1. - t);
+  const auto rr = r * r;
+  const auto rrr = rr * (1. + t);
+  for (size_t n = 0; n <= N; n++) {
+    // 1 / (1 - x)^2 = Σ (k + 1) x^k
+    EXPECT_NEAR(rr.coefficient(n) / static_cast<double>(n + 1), 1., 1e-12);
+    EXPECT_NEAR(rrr.coefficient(n) / static_cast<double>(2 * n + 1), 1., 1e-12);
+  }
+}
+
+TEST(autodiff, SingleVariableDecayingProduct) {
+  // 既定の積は筆算なので、n! で減る係数も相対誤差が小さいまま
+  constexpr size_t N = 63;
+  const auto t = SingleVariable<N, double>(0.);
+  const auto p = (0.7 * t).exp() * (0.5 * t).exp();
+  double factorial = 1.;
+  for (size_t n = 0; n <= N; n++) {
+    factorial *= n == 0 ? 1. : static_cast<double>(n);
+    EXPECT_NEAR(p.coefficient(n) * factorial / std::pow(1.2, n), 1., 1e-12);
+  }
+}
+
+TEST(autodiff, SingleVariableNewton) {
+  // SeriesKaratsuba を有効にすると、係数が 1024 個以上なら逆数・exp・log を
+  // ニュートン法で求める
+  constexpr size_t N = 1023;
+  const auto t = SingleVariable<N, double>(0.);
+  const auto r = 1. / (1. - t);
+  const auto l = (2. - t).log();
+  const auto e = t.exp();
+  const auto q = (0.5 + t).exp() / (1. - t);
+  const auto p = (1. + t).pow(2.5);
+  double factorial = 1.;
+  for (size_t n = 0; n <= N; n++) {
+    factorial *= n == 0 ? 1. : static_cast<double>(n);
+    EXPECT_NEAR(r.coefficient(n), 1., 1e-10);
+    EXPECT_NEAR(l.coefficient(n), n == 0 ? std::log(2.) : -1. / (n * std::pow(2., n)),
+                1e-12);
+    EXPECT_NEAR(e.coefficient(n), 1. / factorial, 1e-12);
+  }
+  const auto slow = SingleVariable<20, double>(0.);
+  const auto expected_q = (0.5 + slow).exp() / (1. - slow);
+  const auto expected_p = (1. + slow).pow(2.5);
+  for (size_t n = 0; n <= 20; n++) {
+    EXPECT_NEAR(q.coefficient(n), expected_q.coefficient(n), 1e-10);
+    EXPECT_NEAR(p.coefficient(n), expected_p.coefficient(n), 1e-12);
+  }
+}
+
+TEST(autodiff, SingleVariableBinary) {
+  const auto z = 0.5 + 2. * x - x * x;
+  const auto p = y.pow(z);
+  const auto expected_p = (z * y.log()).exp();
+  const auto a = atan2(z, y);
+  const auto expected_a = z / y;
+  const auto h = hypot(y, z);
+  const auto expected_h = (y * y + z * z).sqrt();
+  for (size_t i = 0; i <= 5; i++) {
+    EXPECT_NEAR(p.derivative(i), expected_p.derivative(i), 1e-8);
+    EXPECT_NEAR(a.tan().derivative(i), expected_a.derivative(i), 1e-8);
+    EXPECT_NEAR(h.derivative(i), expected_h.derivative(i), 1e-8);
+  }
+}
+
+TEST(autodiff, SingleVariableElementary) {
+  const auto z = 0.3 + 0.2 * x - 0.1 * x * x;
+  const auto sh = (z.exp() - (-z).exp()) / 2.;
+  const auto ch = (z.exp() + (-z).exp()) / 2.;
+  for (size_t i = 0; i <= 5; i++) {
+    EXPECT_NEAR(z.asin().sin().derivative(i), z.derivative(i), 1e-10);
+    EXPECT_NEAR(z.atan().tan().derivative(i), z.derivative(i), 1e-10);
+    EXPECT_NEAR(z.log1p().exp().derivative(i), (1. + z).derivative(i), 1e-10);
+    EXPECT_NEAR(z.expm1().derivative(i), (z.exp() - 1.).derivative(i), 1e-10);
+    EXPECT_NEAR(z.sinh().derivative(i), sh.derivative(i), 1e-10);
+    EXPECT_NEAR(z.cosh().derivative(i), ch.derivative(i), 1e-10);
+    EXPECT_NEAR(z.tanh().derivative(i), (sh / ch).derivative(i), 1e-10);
+  }
+  const auto small = SingleVariable<3, double>(1e-10);
+  EXPECT_EQ(small.expm1().derivative(0), std::expm1(1e-10));
+
+  // erf' = 2 / √π exp(-t^2), erf'' = -2 t erf', erf''' = (4 t^2 - 2) erf'
+  const auto e = SingleVariable<3, double>(0.5).erf();
+  const auto d1 = 2. / std::sqrt(std::numbers::pi) * std::exp(-0.25);
+  EXPECT_NEAR(e.derivative(0), std::erf(0.5), 1e-12);
+  EXPECT_NEAR(e.derivative(1), d1, 1e-12);
+  EXPECT_NEAR(e.derivative(2), -d1, 1e-12);
+  EXPECT_NEAR(e.derivative(3), -d1, 1e-12);
+}
+
+TEST(autodiff, SingleVariableNested) {
+  // 外側を s 方向、内側を t 方向の展開にして f(s, t) の混合微分を求める
+  using Inner = SingleVariable<3, double>;
+  using Outer = SingleVariable<3, Inner>;
+  const auto s = Outer(Autodiff::NumericTraits<Inner>::constant(0.7));
+  auto t = Outer();
+  t.set_value(Inner(1.3));
+  const auto f = (s * t).sin() + s.exp() * t * t / 2.;
+
+  const double s0 = 0.7;
+  const double t0 = 1.3;
+  const double u = s0 * t0;
+  // ∂s∂t f = cos(st) - st sin(st) + t exp(s)
+  EXPECT_NEAR(f.derivative(1).derivative(1),
+              std::cos(u) - u * std::sin(u) + t0 * std::exp(s0), 1e-12);
+  // ∂t^2 f = -s^2 sin(st) + exp(s) を s で 2 回微分したもの
+  EXPECT_NEAR(f.derivative(2).derivative(2),
+              -2. * std::sin(u) - 4. * u * std::cos(u) + u * u * std::sin(u) +
+                  std::exp(s0),
+              1e-12);
+  EXPECT_TRUE(Autodiff::NumericTraits<Outer>::is_zero(f - f));
+}
+
+TEST(autodiff, SingleVariableConstexpr) {
+  // 1 / (1 - s) の k 階微分は k! / (1 - s)^(k + 1)
+  constexpr auto s = SingleVariable<4, double>(0.5);
+  constexpr auto f = 1. / (1. - s);
+  static_assert(f.derivative(0) == 2.);
+  static_assert(f.derivative(3) == 96.);
+  static_assert((f * (1. - s)).derivative(4) == 0.);
+  EXPECT_EQ(f.derivative(4), 768.);
+}
+
+TEST(autodiff, SingleVariableAccessors) {
+  // コンストラクタと get_value / set_value / operator[] は微分係数を扱う
+  auto s = SingleVariable<3, double>(std::array{1., 2., 6., 24.});
+  EXPECT_EQ(s.coefficient(2), 3.);
+  EXPECT_EQ(s.coefficient(3), 4.);
+  EXPECT_EQ(s.get_value(2), 6.);
+  EXPECT_EQ(s[3], 24.);
+  s.set_value(1., 2);
+  EXPECT_EQ(s.derivative(2), 1.);
+  EXPECT_EQ(s.coefficient(2), 0.5);
+  s[3] = 12.;
+  EXPECT_EQ(s.coefficient(3), 2.);
+  s.set_coefficient(1, 5.);
+  EXPECT_EQ(s[1], 5.);
+  // 複合代入も微分係数に対して行う
+  s[3] += 6.;
+  EXPECT_EQ(s.derivative(3), 18.);
+  s[3] -= 3.;
+  s[3] *= 2.;
+  s[3] /= 5.;
+  EXPECT_EQ(s.derivative(3), 6.);
+  s[2] = s[3];
+  EXPECT_EQ(s.coefficient(2), 3.);
+  auto ref = s[1];
+  ref = 7.;
+  EXPECT_EQ(s.derivative(1), 7.);
+  const auto c = SingleVariable<3, double>::from_coefficients({1., 2., 3., 4.});
+  EXPECT_EQ(c.derivative(3), 24.);
+}
@@ -0,0 +1,36 @@
+#include "single_variable_batch.hpp"
+
+#include <gtest/gtest.h>
+
+using Autodiff::SingleVariable;
+using Autodiff::SingleVariableBatch;
+
+using Batch = SingleVariableBatch<5, double, 4>;
+
+static constexpr Batch::Lanes POINTS{0.3, 0.7, 1.1, 2.5};
+
+template <class F> static void expect_lanes(F &&f) {
+  const auto batch = f(Batch(POINTS));
+  for (size_t l = 0; l < POINTS.size(); l++) {
+    const auto single = f(SingleVariable<5, double>(POINTS[l]));
+    for (size_t i = 0; i <= 5; i++) {
+      EXPECT_NEAR(batch.derivative(i, l), single.derivative(i), 1e-8);
+    }
+  }
+}
+
+TEST(autodiff, SingleVariableBatchArithmetic) {
+  expect_lanes([](const auto &x) { return 2.0 + 3.0 * x - x * x / 4.0; });
+  expect_lanes([](const auto &x) { return (x + 1.0) / (x * x + 2.0); });
+  expect_lanes([](const auto &x) { return 1.0 / (x + 0.5); });
+}
+
+TEST(autodiff, SingleVariableBatchFunctions) {
+  expect_lanes([](const auto &x) { return x.exp(); });
+  expect_lanes([](const auto &x) { return x.log(); });
+  expect_lanes([](const auto &x) { return x.pow(1.4); });
+  expect_lanes([](const auto &x) { return x.sqrt(); });
+  expect_lanes([](const auto &x) { return x.sin(); });
+  expect_lanes([](const auto &x) { return x.cos(); });
+  expect_lanes([](const auto &x) { return x.tan(); });
+}
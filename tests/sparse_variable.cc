@@ -0,0 +1,70 @@
+#include "sparse_variable.hpp"
+
+#include <gtest/gtest.h>
+
+using Autodiff::SparseVariable;
+using Autodiff::Variable;
+
+template <size_t Deps, size_t Order>
+static void expect_same(const SparseVariable<Deps, Order> &sparse,
+                        const Variable<Deps, Order> &dense) {
+  const auto converted = sparse.dense();
+  for (size_t i = 0; i < dense.repr.size(); i++) {
+    EXPECT_NEAR(converted.repr[i], dense.repr[i], 1e-10) << "at " << i;
+  }
+}
+
+TEST(autodiff, SparseVariableArithmetic) {
+  SparseVariable<4, 3> a(0.5, 1);
+  SparseVariable<4, 3> b(1.5, 3);
+  Variable<4, 3> da(0.5, 1);
+  Variable<4, 3> db(1.5, 3);
+
+  expect_same(a * b + 2.0 * a, da * db + 2.0 * da);
+  expect_same(a * a * b, da * da * db);
+  expect_same((a * b) * (a + b), (da * db) * (da + db));
+  EXPECT_EQ((a * b).size(), 4);
+}
+
+TEST(autodiff, SparseVariableFunctions) {
+  SparseVariable<4, 3> a(0.5, 2);
+  SparseVariable<4, 3> b(1.5, 4);
+  Variable<4, 3> da(0.5, 2);
+  Variable<4, 3> db(1.5, 4);
+  auto u = a * b + a;
+  auto du = da * db + da;
+
+  expect_same(u.exp(), du.exp());
+  expect_same(u.log(), du.log());
+  expect_same(u.sin(), du.sin());
+  expect_same(u.cos(), du.cos());
+  expect_same(u.tan(), du.tan());
+  expect_same(u.inv(), du.inv());
+  expect_same(u.pow(1.4), du.pow(1.4));
+  // 変数 1, 3 には依存しない
+  const auto e = u.exp();
+  for (const auto &entry : e.nonzeros()) {
+    for (auto i : entry.index) {
+      EXPECT_TRUE(i == 0 || i == 2 || i == 4);
+    }
+  }
+}
+
+TEST(autodiff, SparseVariableSet) {
+  SparseVariable<3, 2> v;
+  v.set({}, 1.0);
+  v.set({2, 1}, 3.0);
+  v.set({1}, 2.0);
+  EXPECT_EQ(v.size(), 3);
+  EXPECT_EQ(v.derivative(1, 2), 3.0);
+  EXPECT_EQ(v.derivative(1), 2.0);
+  EXPECT_EQ(v.derivative(3), 0.0);
+  v.set({1, 2}, 0.0);
+  EXPECT_EQ(v.size(), 2);
+  EXPECT_THROW((SparseVariable<3, 2>(1.0, 0)), std::runtime_error);
+  EXPECT_THROW((SparseVariable<3, 2>(1.0, 4)), std::runtime_error);
+  EXPECT_THROW(v.set({7, 7}, 1.0), std::runtime_error);
+  EXPECT_THROW(v.derivative(4), std::runtime_error);
+  EXPECT_EQ(v.size(), 2);
+  EXPECT_EQ(v.dense().derivative(1), 2.0);
+}
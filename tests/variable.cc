@@ -283,3 +283,365 @@ TEST_F(AutoDiffFixture, VariableCbrt) {
   EXPECT_NEAR(x.cbrt().derivative(2, 3, 3), 1.44444444444444, 1e-8);
   EXPECT_NEAR(x.cbrt().derivative(3, 3, 3), 3.70370370370369, 1e-8);
 }
+
+TEST(autodiff, VariablePackedLayout) {
+  EXPECT_EQ((Variable<3, 3>{}.repr.size()), 20);
+  EXPECT_EQ((Variable<10, 4>{}.repr.size()), 1001);
+
+  Variable<3, 2> v;
+  v.set({2}, 1.0);
+  v.set({2, 1}, 2.0);
+  v.set({1, 3}, 3.0);
+  EXPECT_EQ(v.repr[2], 1.0);
+  EXPECT_EQ(v.repr[5], 2.0);
+  EXPECT_EQ(v.repr[7], 3.0);
+  EXPECT_EQ(v.derivative(1, 2), 2.0);
+  EXPECT_EQ(v.derivative(3, 1), 3.0);
+}
+
+TEST(autodiff, VariableHighOrder) {
+  Variable<2, 5> v;
+  v.set({}, 0.5);
+  v.set({1}, 1.0);
+  v.set({2}, 2.0);
+  auto e = v.exp();
+  EXPECT_NEAR(e.derivative(1, 1, 1, 1, 1), std::exp(0.5), 1e-8);
+  EXPECT_NEAR(e.derivative(2, 1, 2, 1, 1), 4. * std::exp(0.5), 1e-8);
+  EXPECT_NEAR(e.derivative(2, 2, 2, 2, 2), 32. * std::exp(0.5), 1e-8);
+}
+
+// 展開表の大きい形は表を実行時に作るので、定数評価の上限に当たらない
+TEST(autodiff, VariableLargeShapeMul) {
+  static_assert(!Autodiff::MultSchedule<50, 3>::CONSTEXPR_TABLE);
+  const Variable<50, 3> a(0.5, 1);
+  const Variable<50, 3> b(2.0, 50);
+  const auto c = a * b * a;
+  EXPECT_EQ(c.derivative(1, 1), 4.0);
+  EXPECT_EQ(c.derivative(50, 1), 1.0);
+  EXPECT_EQ(c.derivative(50, 1, 1), 2.0);
+  EXPECT_EQ((c / a).derivative(50, 1), 1.0);
+  EXPECT_EQ(((Variable<20, 4>(0.5, 1) * Variable<20, 4>(2.0, 20)))
+                .derivative(20, 1),
+            1.0);
+}
+
+TEST(autodiff, VariableLargeShapeCompose) {
+  static_assert(!Autodiff::CompositionSchedule<10, 5>::CONSTEXPR_TABLE);
+  const auto e = Variable<10, 5>(0.5, 1).exp();
+  EXPECT_NEAR(e.derivative(1, 1, 1, 1, 1), std::exp(0.5), 1e-12);
+  EXPECT_EQ(e.derivative(2, 1), 0.0);
+
+  Variable<2, 8> v(0.5, 1);
+  v.set({2}, 2.0);
+  const auto s = v.sin();
+  EXPECT_NEAR(s.derivative(2, 2, 2, 2, 1, 1, 1, 1), 16. * std::sin(0.5),
+              1e-10);
+}
+
+TEST_F(AutoDiffFixture, VariableCompoundAssign) {
+  auto z = x;
+  z *= y;
+  EXPECT_EQ(z.repr, (x * y).repr);
+  z = x;
+  z *= z;
+  EXPECT_EQ(z.repr, (x * x).repr);
+  z += y;
+  EXPECT_EQ(z.repr, (x * x + y).repr);
+  EXPECT_EQ(z.repr, (y + x * x).repr);
+  z -= y;
+  z /= 2.;
+  EXPECT_EQ(z.repr, (0.5 * (x * x)).repr);
+
+  const auto d = x - y;
+  const auto n = -y;
+  for (size_t i = 0; i < d.repr.size(); i++) {
+    EXPECT_EQ(d.repr[i], x.repr[i] - y.repr[i]);
+    EXPECT_EQ(n.repr[i], -y.repr[i]);
+    EXPECT_EQ((x / 4.).repr[i], x.repr[i] / 4.);
+    EXPECT_EQ((x * y - x).repr[i], (x * y).repr[i] - x.repr[i]);
+    EXPECT_EQ((x - x * y).repr[i], x.repr[i] - (x * y).repr[i]);
+  }
+  EXPECT_EQ((2. - x).derivative(0, 0, 0), 1.);
+  EXPECT_EQ((x - 2.).derivative(0, 0, 0), -1.);
+  EXPECT_EQ((2. - x).derivative(1, 2, 3), -15.);
+}
+
+TEST_F(AutoDiffFixture, VariableDiv) {
+  const auto q = x / y;
+  const auto expected = x * y.inv();
+  const auto r = 2. / y;
+  const auto expected_r = 2. * y.inv();
+  for (size_t i = 0; i < q.repr.size(); i++) {
+    EXPECT_NEAR(q.repr[i], expected.repr[i], 1e-10);
+    EXPECT_NEAR(r.repr[i], expected_r.repr[i], 1e-10);
+  }
+  EXPECT_NEAR((q * y).derivative(1, 2, 3), x.derivative(1, 2, 3), 1e-10);
+
+  auto z = x;
+  z /= z;
+  EXPECT_EQ(z.repr, (Variable<3, 3>(1.).repr));
+}
+
+TEST_F(AutoDiffFixture, VariableBinary) {
+  const auto u = 0.1 * x;
+  const auto v = 0.05 * y;
+  const auto p = u.pow(v);
+  const auto expected_p = (v * u.log()).exp();
+  const auto a = atan2(v, u);
+  const auto expected_a = v / u;
+  const auto h = hypot(u, v);
+  const auto expected_h = (u * u + v * v).sqrt();
+  for (size_t i = 0; i < p.repr.size(); i++) {
+    EXPECT_NEAR(p.repr[i], expected_p.repr[i], 1e-8);
+    EXPECT_NEAR(a.tan().repr[i], expected_a.repr[i], 1e-8);
+    EXPECT_NEAR(h.repr[i], expected_h.repr[i], 1e-8);
+  }
+}
+
+TEST_F(AutoDiffFixture, VariableElementary) {
+  const auto u = 0.01 * x;
+  const auto as = u.asin().sin();
+  const auto at = u.atan().tan();
+  const auto th = u.tanh();
+  const auto expected_th = u.sinh() / u.cosh();
+  const auto lp = u.log1p();
+  const auto expected_lp = (1. + u).log();
+  for (size_t i = 0; i < u.repr.size(); i++) {
+    EXPECT_NEAR(as.repr[i], u.repr[i], 1e-10);
+    EXPECT_NEAR(at.repr[i], u.repr[i], 1e-10);
+    EXPECT_NEAR(th.repr[i], expected_th.repr[i], 1e-10);
+    EXPECT_NEAR(lp.repr[i], expected_lp.repr[i], 1e-10);
+    EXPECT_NEAR(u.expm1().repr[i], (u.exp() - 1.).repr[i], 1e-10);
+  }
+  EXPECT_NEAR(u.erf().derivative(0, 0, 0), std::erf(0.01), 1e-12);
+  EXPECT_NEAR(u.erf().derivative(1, 0, 0),
+              2. / std::sqrt(std::numbers::pi) * std::exp(-1e-4) * 0.02,
+              1e-12);
+}
+
+TEST_F(AutoDiffFixture, VariableExtraction) {
+  std::array<double, 3> grad{};
+  x.gradient(grad);
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(grad[i], x.derivative(i + 1));
+  }
+
+  std::array<double, 6> packed{};
+  std::array<double, 9> full{};
+  x.packed_hessian(packed);
+  x.hessian(full);
+  for (size_t i = 0, p = 0; i < 3; i++) {
+    for (size_t j = 0; j <= i; j++, p++) {
+      EXPECT_EQ(packed[p], x.derivative(i + 1, j + 1));
+    }
+    for (size_t j = 0; j < 3; j++) {
+      EXPECT_EQ(full[i * 3 + j], x.derivative(i + 1, j + 1));
+    }
+  }
+
+  std::array<double, 27> third{};
+  x.tensor<3>(third);
+  for (size_t i = 0; i < 27; i++) {
+    EXPECT_EQ(third[i], x.derivative(i / 9 + 1, i / 3 % 3 + 1, i % 3 + 1));
+  }
+  std::array<double, 10> packed_third{};
+  x.packed_tensor<3>(packed_third);
+  EXPECT_EQ(packed_third.front(), x.derivative(1, 1, 1));
+  EXPECT_EQ(packed_third.back(), x.derivative(3, 3, 3));
+
+  const std::array ys{x, y};
+  std::array<double, 6> jac{};
+  Autodiff::jacobian<3, 3>(ys, jac);
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(jac[i], x.derivative(i + 1));
+    EXPECT_EQ(jac[3 + i], y.derivative(i + 1));
+  }
+  std::array<double, 2> wrong{};
+  EXPECT_THROW(x.gradient(wrong), std::runtime_error);
+}
+
+TEST_F(AutoDiffFixture, VariableValType) {
+  Variable<3, 3, float> xf;
+  Variable<3, 3, long double> xl;
+  for (size_t i = 0; i < x.repr.size(); i++) {
+    xf.repr[i] = static_cast<float>(x.repr[i]);
+    xl.repr[i] = x.repr[i];
+  }
+  static_assert(sizeof(xf.repr) * 2 == sizeof(x.repr));
+  const auto ef = (xf * xf / 2.f).sin();
+  const auto el = (xl * xl / 2.L).sin();
+  const auto e = (x * x / 2.).sin();
+  for (size_t i = 0; i < x.repr.size(); i++) {
+    EXPECT_NEAR(ef.repr[i], e.repr[i], 1e-3 * (1. + std::abs(e.repr[i])));
+    EXPECT_NEAR(static_cast<double>(el.repr[i]), e.repr[i], 1e-10);
+  }
+}
+
+TEST_F(AutoDiffFixture, VariableNested) {
+  // 係数を SingleVariable にして 3 つ目の方向の微分を重ねて持つ
+  using Inner = Autodiff::SingleVariable<2, double>;
+  using Nested = Variable<2, 2, Inner>;
+  using Traits = Autodiff::NumericTraits<Inner>;
+  const auto a = Nested(Traits::constant(0.5), 1);
+  const auto b = Nested(Traits::constant(0.3), 2);
+  const auto c = Nested(Inner(0.2));
+  const auto f = (a * b * c).sin() + a.exp() / (1. + c * c) - pow(b, c);
+
+  const auto x1 = Variable<3, 4>(0.5, 1);
+  const auto x2 = Variable<3, 4>(0.3, 2);
+  const auto x3 = Variable<3, 4>(0.2, 3);
+  auto g = (x1 * x2 * x3).sin() + x1.exp() / (1. + x3 * x3) - pow(x2, x3);
+
+  EXPECT_NEAR(f.repr[0].derivative(0), g.repr[0], 1e-12);
+  EXPECT_NEAR(f.repr[0].derivative(1), g.derivative(3), 1e-12);
+  EXPECT_NEAR(f.repr[0].derivative(2), g.derivative(3, 3), 1e-12);
+  auto h = f;
+  EXPECT_NEAR(h.derivative(1).derivative(1), g.derivative(1, 3), 1e-12);
+  EXPECT_NEAR(h.derivative(1, 2).derivative(0), g.derivative(1, 2), 1e-12);
+  EXPECT_NEAR(h.derivative(1, 2).derivative(1), g.derivative(1, 2, 3), 1e-12);
+  EXPECT_NEAR(h.derivative(2, 2).derivative(2), g.derivative(2, 2, 3, 3),
+              1e-12);
+}
+
+TEST_F(AutoDiffFixture, VariableStructuralZero) {
+  using V = Variable<4, 3>;
+  const auto a = V(0.5, 1);
+  const auto b = V(0.3, 2);
+  EXPECT_TRUE(a.depends_on().test(1));
+  EXPECT_FALSE(a.depends_on().test(2));
+  EXPECT_TRUE(V(2.).depends_on().all());
+
+  // set で作った独立変数は全入力に依存するとみなされ、飛ばさずに計算される
+  V da;
+  da.set({}, 0.5);
+  da.set({1}, 1.);
+  V db;
+  db.set({}, 0.3);
+  db.set({2}, 1.);
+  EXPECT_TRUE(da.depends_on().all());
+
+  const auto f = (a * b).exp() / (1. + a * a) + pow(a, b) - atan2(a, b);
+  auto g = (da * db).exp() / (1. + da * da) + pow(da, db) - atan2(da, db);
+  auto h = f;
+  EXPECT_TRUE(h.depends_on().test(1));
+  EXPECT_TRUE(h.depends_on().test(2));
+  EXPECT_FALSE(h.depends_on().test(3));
+  EXPECT_FALSE(h.depends_on().test(4));
+  for (size_t i = 0; i < f.repr.size(); i++) {
+    EXPECT_DOUBLE_EQ(f.repr[i], g.repr[i]);
+  }
+  EXPECT_EQ(h.derivative(1, 3), 0.);
+  EXPECT_NE(h.derivative(1, 2, 2), 0.);
+
+  // 独立変数を足すと依存先が増える
+  h += V(0.1, 4);
+  EXPECT_TRUE(h.depends_on().test(4));
+  EXPECT_EQ(h.derivative(4), 1.);
+}
+
+// 静的な PooledStorage はスレッドの空きリストより後に破棄される
+static const Variable<20, 3> pooled_global(0.5, 1);
+
+TEST_F(AutoDiffFixture, VariableStorage) {
+  static_assert(std::same_as<decltype(x.repr), std::array<double, 20>>);
+  static_assert(std::same_as<decltype(Variable<20, 3>().repr),
+                             Autodiff::PooledStorage<double, 1771>>);
+
+  using Pooled = Variable<3, 3, double, Autodiff::PooledStorage>;
+  Pooled p;
+  for (size_t i = 0; i < x.repr.size(); i++) {
+    p.repr[i] = x.repr[i];
+  }
+  const auto e = (x * x / 2.).sin() + x.exp();
+  const auto ep = (p * p / 2.).sin() + p.exp();
+  for (size_t i = 0; i < x.repr.size(); i++) {
+    EXPECT_EQ(ep.repr[i], e.repr[i]);
+  }
+
+  // キャッシュライン境界に揃い、ムーブではバッファを付け替えるだけ
+  const auto *data = p.repr.data();
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % Autodiff::StorageAlignment,
+            0U);
+  auto moved = std::move(p);
+  EXPECT_EQ(moved.repr.data(), data);
+
+  // 解放したバッファは同じスレッドで使い回される
+  { const auto tmp = std::move(moved); }
+  const Pooled reused(1., 1);
+  EXPECT_EQ(reused.repr.data(), data);
+  EXPECT_EQ(reused.repr[0], 1.);
+  EXPECT_EQ(reused.repr[2], 0.);
+  EXPECT_EQ((pooled_global * pooled_global).derivative(1, 1), 2.);
+}
+
+TEST(autodiff, PooledStorageMovedFrom) {
+  // ムーブ元は新しいバッファを持ち、コピーも書き込みもできる
+  using Pooled = Variable<3, 3, double, Autodiff::PooledStorage>;
+  Pooled p(2., 1);
+  const auto moved = std::move(p);
+  EXPECT_EQ(moved.derivative(1), 1.);
+  EXPECT_NE(p.repr.data(), moved.repr.data());
+  EXPECT_EQ(p.repr[0], 0.);
+  const auto copy = p;
+  EXPECT_EQ(copy.repr[1], 0.);
+  p = moved;
+  p.repr[0] = 3.;
+  EXPECT_EQ((p * p).derivative(1), 6.);
+  EXPECT_EQ(moved.repr[0], 2.);
+}
+
+// 有理演算と係数の取り出しは定数式で評価でき、結果を実行ファイルに埋め込める
+constexpr auto rational = [] {
+  const Variable<2, 3> a(0.5, 1);
+  const Variable<2, 3> b(1., 2);
+  return (a * b + 2. * a * a) / (1. + b);
+}();
+
+constexpr auto rational_hessian = [] {
+  std::array<double, 4> ret{};
+  rational.hessian(ret);
+  return ret;
+}();
+
+TEST_F(AutoDiffFixture, VariableConstexpr) {
+  // f = (ab + 2a^2) / (1 + b) の a = 1/2, b = 1 での値
+  static_assert(rational.repr[0] == 0.5);
+  static_assert(rational.derivative(1) == 1.5);
+  static_assert(rational.derivative(2) == 0.);
+  static_assert(rational.derivative(1, 1) == 2.);
+  static_assert(rational_hessian[1] == -0.25);
+  static_assert(rational_hessian[1] == rational_hessian[2]);
+  static_assert([] {
+    Variable<2, 3> v;
+    v.set({1, 2}, 3.);
+    return v.derivative(2, 1);
+  }() == 3.);
+  // PooledStorage も定数式の中では std::allocator で確保する
+  static_assert([] {
+    const Variable<20, 3> v(0.5, 1);
+    return (v * v).derivative(1, 1);
+  }() == 2.);
+  EXPECT_EQ(rational.derivative(1, 2), -0.25);
+}
+
+TEST(autodiff, InternalNumBounds) {
+  using Num = Autodiff::InternalNum<3, 3>;
+  EXPECT_EQ(Num(19).get_repr(), 19U);
+  EXPECT_THROW(Num(20), std::runtime_error);
+}
+
+TEST(autodiff, VariableSeedIndex) {
+  EXPECT_THROW((Variable<3, 2>(1.0, 0)), std::runtime_error);
+  EXPECT_THROW((Variable<3, 2>(1.0, 4)), std::runtime_error);
+  EXPECT_EQ((Variable<3, 2>(1.0, 3)).derivative(3), 1.0);
+}
+
+TEST(autodiff, VariableStructuralZeroDirectWrite) {
+  // 定数から始めて repr に直接微分係数を書いても飛ばされない
+  Variable<2, 2> c(2.0);
+  c.repr[1] = 1.0;
+  EXPECT_EQ((c * c).derivative(1), 4.0);
+  EXPECT_EQ(c.exp().derivative(1), std::exp(2.0));
+  EXPECT_EQ((1. / c).derivative(1), -0.25);
+  EXPECT_EQ((c / c).derivative(1), 0.0);
+}